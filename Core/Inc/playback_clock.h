@@ -0,0 +1,22 @@
+#pragma once
+
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+
+// Presentation clock: TIM2 free running at 1MHz (see MX_TIM2_Init in main.c).
+// The counter is 32-bit and wraps after ~71 minutes; differences between two
+// readings stay correct across the wrap as long as they are computed in uint32_t.
+
+// Redefine if necessary
+#define PLAYBACK_CLOCK_TIM htim2
+extern TIM_HandleTypeDef PLAYBACK_CLOCK_TIM;
+
+void PlaybackClock_Start(void);
+uint32_t PlaybackClock_Micros(void);
+
+// CPU cycle counter (DWT CYCCNT, started by PlaybackClock_Start), for timing short sections such as
+// one decoder call; wraps after ~50s at 84MHz
+uint32_t PlaybackClock_Cycles(void);
+
+// busy-wait until the clock reaches `deadline_us`; returns immediately if it already passed
+void PlaybackClock_WaitUntil(uint32_t deadline_us);
@@ -0,0 +1,34 @@
+#pragma once
+#include "sd_playback.h"
+
+// Device profile for the converter's cost model (video_converter.py --profile): SD read and
+// display write throughput and the decoder cost of each frame type, measured on this board.
+// The calibration pass times the display directly, plays PLAYBACK_PROFILE_CALIB_PATH (written by
+// video_converter.py --calibration, unpaced) and writes the results to PLAYBACK_PROFILE_PATH:
+//     cpu_hz <Hz>
+//     sd_bytes_per_ms <n>          f_read throughput over whole frames, frame headers included
+//     display_bytes_per_ms <n>     pixel bytes streamed into one RAMWR window
+//     window_us <n>                cost of opening a window (CASET, RASET, RAMWR)
+//     decode <type> <c.cc>         decoder cycles per pixel, one line per frame type played
+//     entropy <c.cc>               entropy decoder cycles per byte, if the video had entropy coded frames
+#define PLAYBACK_PROFILE_CALIB_PATH "/calib.bin"
+#define PLAYBACK_PROFILE_PATH       "/profile.txt"
+#define PLAYBACK_PROFILE_WINDOWS    64      // 8x8 windows opened to time the cost of a window
+
+typedef struct PlaybackProfile {
+    uint32_t cpu_hz;
+    uint32_t sd_bytes_per_ms;
+    uint32_t display_bytes_per_ms;
+    uint32_t window_us;
+    uint32_t decode_cycles_x100[VidFrame_COUNT];    // per pixel, 0 = frame type not played
+    uint32_t entropy_cycles_x100;                   // per byte, 0 = no entropy coded frames
+} PlaybackProfile;
+
+// The calibration video is on the card and no profile has been written yet; delete the profile
+// to calibrate again. Requires a mounted card.
+bool PlaybackProfile_Pending(void);
+
+// Blocking: measure the display, play the calibration video to the end and write the profile.
+// `player` is only used during the call (e.g. a playlist's player before SDPlaylist_Open).
+FRESULT PlaybackProfile_Calibrate(SDPlayback* player, PlaybackProfile* profile);
+FRESULT PlaybackProfile_Write(const PlaybackProfile* profile, const char* path);
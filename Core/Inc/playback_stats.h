@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+
+#include "vid_format.h"
+
+// Per-frame timing statistics kept in RAM. Recording a sample is a few adds and a bucket
+// increment, so it can stay enabled during playback; printing goes over the (blocking) UART
+// and should be done between clips or on demand.
+
+// Histogram resolution: samples above the last bucket are counted in it (max stays exact)
+#define PLAYBACK_STATS_BUCKET_US    500
+#define PLAYBACK_STATS_BUCKETS      64
+
+typedef struct PlaybackHistogram {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[PLAYBACK_STATS_BUCKETS];
+} PlaybackHistogram;
+
+typedef struct PlaybackStats {
+    PlaybackHistogram read;     // time in f_read for the frame (header + all bands)
+    PlaybackHistogram draw;     // RAMWR window opened to last band handed to DMA
+    PlaybackHistogram total;    // frame load started to last band handed to DMA
+    uint64_t read_bytes;        // bytes read from the card in the time summed by `read`
+
+    // CPU cycles spent in the decoder and pixels it produced, per frame type (raw frames are not decoded)
+    uint64_t decode_cycles[VidFrame_COUNT];
+    uint32_t decode_pixels[VidFrame_COUNT];
+
+    // entropy coded frames: CPU cycles spent in the entropy decoder per frame, and bytes it produced
+    uint32_t entropy_frames;
+    uint32_t entropy_max_cycles;
+    uint64_t entropy_cycles;
+    uint64_t entropy_bytes;
+} PlaybackStats;
+
+void PlaybackStats_Reset(PlaybackStats* stats);
+void PlaybackStats_Record(PlaybackStats* stats, uint32_t read_us, uint32_t read_bytes, uint32_t draw_us,
+                          uint32_t total_us);
+void PlaybackStats_RecordDecode(PlaybackStats* stats, uint8_t frame_type, uint32_t cycles, uint32_t pixels);
+void PlaybackStats_RecordEntropy(PlaybackStats* stats, uint32_t cycles, uint32_t bytes);  // once per frame
+void PlaybackStats_Merge(PlaybackStats* dst, const PlaybackStats* src);
+
+// percentile (0..100) in microseconds, resolved to the upper edge of a bucket
+uint32_t PlaybackHistogram_Percentile(const PlaybackHistogram* hist, uint32_t percent);
+
+// one line per histogram: count, min, mean, p50, p90, p99 and max in microseconds, the SD read
+// throughput, then the decoder cost in cycles per pixel of each frame type that was decoded and the entropy decoder
+// cost per frame and per byte
+void PlaybackStats_Print(const PlaybackStats* stats);
@@ -1,5 +1,128 @@
 #pragma once
 #include "fatfs.h"
+#include "vid_format.h"
+#include "vid_codec.h"
+#include "playback_stats.h"
+#include <stdbool.h>
 
+#define VID_BIN_PATH "/vid/video.bin"
+
+// Frames are streamed to the display in bands. Each band is read from the SD card (SPI2) into
+// one buffer of a small ring while the previous band is still being sent to the display (SPI1),
+// inside a single RAMWR window per frame.
+// Band size is in bytes and need not be a whole number of lines. It must be a multiple of 512 (sector size)
+// so band reads of sector-aligned files stay on whole sectors.
+// SDPLAYBACK_BAND_SIZE = (w * h * 2) with 2 bands gives whole-frame double buffering (~80KB).
+#define SDPLAYBACK_BAND_SIZE    2048
+#define SDPLAYBACK_BAND_COUNT   2
+
+// Input buffer for coded frames: compressed payload is read in chunks of this size (a multiple of 512)
+// and decoded into the band ring. Raw frames are read straight into the bands.
+#define SDPLAYBACK_IN_SIZE      1024
+
+// Entropy coded frames (VID_FLAG_ENTROPY) are read in chunks of SDPLAYBACK_IN_SIZE into a second
+// buffer and decoded into the input buffer through a lookup table built from the file's code
+// table; together ~3KB per player.
+
+// Reference frame for files with motion frames (VID_FLAG_MOTION), shared by all players: it holds
+// what is on screen. Takes ST7735_WIDTH * (ST7735_HEIGHT + 16) * 2 bytes (~44KB); set to 0 to
+// drop it, files with motion frames then fail to open.
+#define SDPLAYBACK_REF_FRAME    1
+
+// Cluster link map table (FatFs fast seek) length in DWORDs: 2 per file fragment + 2.
+// Files with more fragments than fit fall back to normal seeking, which follows the FAT chain.
+#define SDPLAYBACK_CLMT_LEN     32
+
+typedef enum SDPlayback_State {
+    SDPlayback_CLOSED,
+    SDPlayback_READY,       // opened, not started
+    SDPlayback_PLAYING,
+    SDPlayback_PAUSED,
+    SDPlayback_FINISHED,    // all frames presented
+    SDPlayback_ERROR,       // see SDPlayback.error
+} SDPlayback_State;
+
+// Player handle. Owns the open file and its band ring; treat the fields as read-only.
+typedef struct SDPlayback {
+    FIL file;
+    DWORD clmt[SDPLAYBACK_CLMT_LEN];    // fast seek table, file.cltbl points here when it fits
+    DWORD lba;                  // first sector of a contiguous file read with disk_read() (0 = use f_read)
+    FSIZE_t lba_pos;            // file position in raw LBA mode
+    VidInfo info;
+    SDPlayback_State state;
+    FRESULT error;
+
+    uint32_t frame;             // next frame to present
+    uint32_t frame_remaining;   // payload bytes of the current frame not yet read (0 = between frames)
+    uint32_t frame_padding;     // zero padding after the payload, read but not drawn (aligned files)
+    uint8_t frame_type;         // VidFrameType of the current frame (without VID_FRAME_ENTROPY)
+    bool entropy;               // current frame is entropy coded
+    VidDecoder dec;             // coded frames: dec.out_remaining pixel bytes still to decode
+    bool refresh;               // present one frame while paused (after a seek)
+    VidRect window;             // display window of the band being produced
+    bool window_pending;        // window not opened yet
+    uint32_t window_pos;        // bytes submitted into the window
+    VidRef* ref;                // motion files: shared reference frame, kept up to date as bands are submitted
+    bool drawing;               // this player opened the display's RAMWR window
+
+    // one sector of the frame index; index_block is the cached block number (UINT32_MAX = none)
+    uint8_t index_cache[VID_SECTOR_SIZE] __attribute__((aligned(4)));
+    uint32_t index_block;
+
+    uint8_t bands[SDPLAYBACK_BAND_COUNT][SDPLAYBACK_BAND_SIZE] __attribute__((aligned(4)));
+    uint32_t band_idx;          // next ring buffer to fill
+    uint8_t* band_pending;      // filled band waiting for SPI1 to become free
+    UINT band_pending_len;
+    uint8_t* out_band;          // coded frames: band being decoded into
+    UINT out_len;
+
+    uint8_t in_buf[VID_CODEC_MAX_TOKEN + SDPLAYBACK_IN_SIZE];
+    UINT in_pos;
+    UINT in_len;
+
+    // entropy coded frames: lookup table (VidHuff_Build) and coded payload chunk
+    uint16_t huff_lookup[1 << VID_HUFF_MAX_BITS];
+    VidHuff_State huff;
+    uint8_t coded_buf[SDPLAYBACK_IN_SIZE];
+    UINT coded_pos;
+    UINT coded_len;
+
+    // presentation clock, see playback_clock.h
+    uint32_t start_us;          // clock time at which frame 0 is due (shifted on pause and seek)
+    uint32_t pause_us;
+    uint32_t dropped_frames;
+
+    // timings of the current frame, recorded into stats when its last band is submitted
+    uint32_t frame_start_us;
+    uint32_t frame_draw_us;     // clock time the frame's first RAMWR window was opened
+    bool frame_draw_started;
+    uint32_t frame_read_us;     // accumulated time in f_read
+    uint32_t frame_read_bytes;  // and payload bytes it read
+    uint32_t frame_entropy_cycles;  // accumulated cycles in the entropy decoder
+    uint32_t frame_entropy_bytes;   // and bytes it produced
+    PlaybackStats stats;
+} SDPlayback;
+
+FRESULT SDPlayback_Mount(void);
+void SDPlayback_Unmount(void);
+
+// Non-blocking player: open a file, start it with SDPlayback_Play(), then call SDPlayback_Poll()
+// from the main loop. Each poll does a bounded amount of work (at most one band read) and never
+// waits on DMA or on the presentation clock; other work can run between polls.
+FRESULT SDPlayback_Open(SDPlayback* player, const char* path);
+void SDPlayback_Play(SDPlayback* player);
+void SDPlayback_PlayAt(SDPlayback* player, uint32_t due_us);  // current frame due at `due_us` (playback clock)
+void SDPlayback_Pause(SDPlayback* player);
+FRESULT SDPlayback_Seek(SDPlayback* player, uint32_t frame);  // constant time with fast seek and a frame index
+SDPlayback_State SDPlayback_Poll(SDPlayback* player);
+void SDPlayback_Close(SDPlayback* player);
+
+// Read the first frame header and band of a READY player without touching the display, so a
+// following SDPlayback_Play() can present it without waiting for the card
+FRESULT SDPlayback_Preroll(SDPlayback* player);
+
+// Presentation time of the end of the last frame (now for unpaced files)
+uint32_t SDPlayback_EndTime(const SDPlayback* player);
+
+// Blocking helper: mount the card and play VID_BIN_PATH to the end
 FRESULT SDPlayback_Begin();
-void SDPlayback_Unmount();
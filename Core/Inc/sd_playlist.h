@@ -0,0 +1,47 @@
+#pragma once
+#include "sd_playback.h"
+
+// Playlist: plays every file matching SDPLAYLIST_PATTERN in a directory, in directory order.
+// Two players are used in turn: while one plays the last SDPLAYLIST_PREROLL_FRAMES frames of its
+// clip, the next file is opened and its first band read into the other, and it starts on the
+// presentation clock exactly where the previous clip ends.
+#define SDPLAYLIST_DIR              "/vid"
+#define SDPLAYLIST_PATTERN          "*.bin"
+#define SDPLAYLIST_PREROLL_FRAMES   4
+#define SDPLAYLIST_PATH_LEN         32      // dir + '/' + 8.3 name (_USE_LFN is 0)
+
+typedef enum SDPlaylist_Preroll {
+    SDPlaylist_PREROLL_FIND,    // look up the next file name
+    SDPlaylist_PREROLL_OPEN,    // open it and read the header
+    SDPlaylist_PREROLL_FILL,    // read the first frame header and band
+    SDPlaylist_PREROLL_DONE,    // next player ready (or no next file, see has_next)
+} SDPlaylist_Preroll;
+
+typedef struct SDPlaylist {
+    SDPlayback players[2];
+    uint8_t current;            // index of the playing player in players[]
+    const char* dir;
+    bool loop;                  // restart from the first file after the last one
+
+    DIR dir_obj;
+    FILINFO fno;
+    char next_path[SDPLAYLIST_PATH_LEN];
+    SDPlaylist_Preroll preroll;
+    bool has_next;
+    bool pass_ok;               // a file opened successfully since the directory was last rewound
+
+    SDPlayback_State state;     // PLAYING, FINISHED or ERROR
+    FRESULT error;
+    PlaybackStats stats;        // frame timings of all finished clips
+    uint32_t dropped_frames;
+} SDPlaylist;
+
+// Requires a mounted card (SDPlayback_Mount). Starts playing the first file that opens.
+FRESULT SDPlaylist_Open(SDPlaylist* list, const char* dir, bool loop);
+SDPlayback_State SDPlaylist_Poll(SDPlaylist* list);
+void SDPlaylist_Close(SDPlaylist* list);
+
+// player of the clip on screen; may be paused or seeked with the SDPlayback API
+static inline SDPlayback* SDPlaylist_Current(SDPlaylist* list) {
+    return &list->players[list->current];
+}
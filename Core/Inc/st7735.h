@@ -20,7 +20,8 @@ extern SPI_HandleTypeDef ST7735_SPI_PORT;
 
 // -----------------------------------------------------------------------------
 
-// Color implementation: Use 16 bit / pixel (IFPF[2:0] = 101) (Set using COLMOD command)
+// Color implementation: Use 16 bit / pixel (IFPF[2:0] = 101) (Set using COLMOD command).
+// Streamed writes can also use 12 bit / pixel (IFPF[2:0] = 011), see ST7735_BeginWriteMode().
 
 // Pin Connections:
 //  LED (Backlight) - 3.3V
@@ -139,6 +140,12 @@ extern SPI_HandleTypeDef ST7735_SPI_PORT;
 // (b & 11111000) >> 3
 #define ST7735_COLOR565(r, g, b) (((r & 0xF8) << 8) | ((g & 0xFC) << 3) | ((b & 0xF8) >> 3))
 
+// COLMOD interface pixel formats (IFPF[2:0])
+typedef enum {
+    ST7735_COLOR_12BIT = 0x03,  // RGB444, two pixels in three bytes: [R1 G1][B1 R2][G2 B2]
+    ST7735_COLOR_16BIT = 0x05,  // RGB565, two bytes per pixel (default)
+} ST7735_ColorMode;
+
 // GAMSET command curve selection for GS=0
 typedef enum {
     GAMMA_10 = 0x01, // 1.0
@@ -163,6 +170,23 @@ void ST7735_FillRectangleFast(uint16_t x, uint16_t y, uint16_t w, uint16_t h, ui
 void ST7735_FillScreen(uint16_t color);
 void ST7735_FillScreenFast(uint16_t color);
 void ST7735_DrawImage(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t* data);
+
+// Non-blocking ST7735_DrawImage: starts the DMA transfer and returns immediately.
+// `data` must stay valid and the display must not be used until ST7735_WaitDrawImage() returns.
+void ST7735_DrawImageAsync(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t* data);
+void ST7735_WaitDrawImage(void);
+bool ST7735_IsBusy(void);
+
+// Streamed image write: open one RAMWR window, then send the pixel data in chunks.
+// ST7735_WriteAsync() waits for the previous chunk only, so the caller may fill the next
+// chunk while the current one is transmitted. Close the window with ST7735_WaitDrawImage().
+void ST7735_BeginWrite(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+// ST7735_BeginWrite() with the window's data in `mode`. COLMOD is only sent when the mode changes;
+// the other drawing functions switch back to 16 bit. In 12 bit mode, w * h must be even.
+void ST7735_BeginWriteMode(uint16_t x, uint16_t y, uint16_t w, uint16_t h, ST7735_ColorMode mode);
+void ST7735_WriteAsync(const uint8_t* data, size_t len);
+
 void ST7735_InvertColors(bool invert);
 void ST7735_SetGamma(GammaDef gamma);
 
@@ -35,4 +35,8 @@ extern DRESULT USER_SPI_read (BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
   extern DRESULT USER_SPI_ioctl (BYTE pdrv, BYTE cmd, void *buff);
 #endif /* _USE_IOCTL == 1 */
 
+//open-ended multi block read across calls, see user_diskio_spi.c
+extern DRESULT USER_SPI_StreamRead (BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+extern void USER_SPI_StreamStop (BYTE pdrv);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vid_format.h"
+
+// Decoders for coded frame types (see "Frame types" in README.md). A decoder turns a frame
+// payload, delivered in chunks as it is read from the card, into the frame's RGB565 pixel
+// stream in raster order, one output band at a time. Decoding can stop and resume at any
+// input or output boundary.
+// Frame types that update rectangles (delta and JPEG frames) produce the pixels of each rectangle in
+// turn; they report the rectangle in `rect` and end the output band at its last pixel.
+
+// Longest token a decoder needs whole before it can decode it. A decoder stops with fewer than
+// this many input bytes left only when the payload has no more; the caller moves the leftover
+// bytes in front of the next chunk.
+#define VID_CODEC_MAX_TOKEN     8
+
+// Input chunk: the decoder advances ptr
+typedef struct VidCodec_In {
+    const uint8_t* ptr;
+    const uint8_t* end;
+} VidCodec_In;
+
+typedef struct VidRect {
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+} VidRect;
+
+// Type 1 (RLE): LVGL RLE stream with 2-byte blocks. A control byte with bit 7 set is followed by
+// (ctrl & 0x7F) literal pixels; otherwise the single pixel that follows is repeated ctrl times.
+typedef struct VidRle_State {
+    uint16_t left;              // output bytes left in the current run
+    bool literal;
+    uint8_t value[2];           // repeated pixel
+} VidRle_State;
+
+// Type 2 (DELTA): [rect_count (u16)][pixel_bytes (u32)], then per rectangle
+// [x][y][w][h] (u16 each) and w * h RGB565 pixels (RGB444 files: w * h even, w * h * 3 / 2 bytes)
+#define VID_DELTA_HEADER_LEN    6
+#define VID_DELTA_RECT_LEN      8
+
+typedef struct VidDelta_State {
+    bool header_done;
+    uint16_t rects_left;        // rectangles whose header is not read yet
+    uint32_t rect_left;         // output bytes left in the current rectangle
+} VidDelta_State;
+
+// Type 3 (MOTION): the frame in 8x8 blocks, block rows top to bottom and blocks left to right.
+// Each block is described by a control byte:
+//   0x00..0x7F  skip: ctrl + 1 blocks unchanged from the previous frame
+//   0x80        raw: 8 lines of 8 RGB565 pixels follow (128 bytes)
+//   0x81        copy: the block of the previous frame at (x + dx, y + dy); one byte follows,
+//               dx in the high nibble and dy in the low nibble, each 4-bit two's complement
+// Copied blocks lie within the frame. Width and height are multiples of 8.
+#define VID_MOTION_BLOCK        8
+#define VID_MOTION_RAW          0x80
+#define VID_MOTION_COPY         0x81
+#define VID_MOTION_RAW_LEN      (VID_MOTION_BLOCK * VID_MOTION_BLOCK * 2)
+
+// Reference frame of motion frames: the last frame drawn, in a ring of VID_REF_LINES(height)
+// lines. A motion frame is decoded over its own reference: block row r is written two block rows
+// above frame line 8r, over lines that no later block can copy from, and the frame moves up by
+// two block rows when it is complete.
+#define VID_REF_LINES(height)   ((height) + 2 * VID_MOTION_BLOCK)
+
+typedef struct VidRef {
+    uint8_t* pixels;            // width * VID_REF_LINES(height) * 2 bytes
+    uint32_t size;
+    uint16_t width;             // geometry of the frame held, 0 = none
+    uint16_t height;
+    uint16_t lines;
+    uint16_t top;               // ring line of frame line 0
+} VidRef;
+
+typedef struct VidMotion_State {
+    uint16_t row;               // block row being decoded or copied out
+    uint16_t block;             // next block of the row to decode
+    uint16_t skip_left;         // blocks left in a skip run
+    uint8_t raw_left;           // bytes of the current raw block not read yet
+    bool emit;                  // row decoded, being copied out
+    uint32_t emit_pos;          // bytes of the row copied out
+} VidMotion_State;
+
+// Type 4 (I8): [palette_len (u16)][palette_len RGB565 colors][one palette index per pixel].
+// palette_len is 1..256; indices past it are drawn black.
+// Type 5 (I4): the same with palette_len 1..16 and two pixels per byte, the first in the high
+// nibble. A frame with an odd number of pixels ends with a padding nibble.
+#define VID_PALETTE_MAX         256
+#define VID_I4_PALETTE_MAX      16
+
+typedef struct VidPalette_State {
+    uint16_t len;               // palette entries in the payload, 0 = header not read yet
+    uint16_t loaded;            // palette entries read
+    uint16_t colors[VID_PALETTE_MAX]; // RGB565 in display byte order
+
+    // I4: both pixels of every index byte, built once the palette is loaded
+    uint32_t pairs[256];
+    bool half;                  // the low pixel of the last byte is still to be drawn
+    uint16_t half_color;
+} VidPalette_State;
+
+// Type 6 (MONO): [fg (RGB565)][bg (RGB565)][coding (u8)], then
+//   coding 0 (VID_MONO_BITS): one bit per pixel, MSB first, 1 = fg, padded to a whole byte
+//   coding 1 (VID_MONO_RUNS): run lengths in pixels, alternately bg and fg starting with bg,
+//                             each a LEB128 varint (7 bits per byte, low bits first) of at most 3 bytes
+#define VID_MONO_HEADER_LEN     5
+#define VID_MONO_BITS           0
+#define VID_MONO_RUNS           1
+#define VID_MONO_VARINT_MAX     3
+
+typedef struct VidMono_State {
+    bool header_done;
+    uint8_t coding;
+    uint8_t colors[2][2];       // bg, fg in display byte order
+    uint8_t bits;               // bits: byte being drawn
+    uint8_t bits_left;          // bits: pixels of `bits` not drawn yet
+    bool run_fg;                // runs: color of the current run
+    uint32_t run_left;          // runs: pixels left in the current run
+    uint16_t quads[16][4];      // bits: the 4 pixels of each nibble
+} VidMono_State;
+
+// Type 7 (YUV420): full range BT.601 YCbCr (JPEG), U and V shared by each 2x2 block of pixels.
+// Even lines are groups [Y0][Y1][U][V] for pixels x, x + 1; odd lines are groups [Y0][Y1] that reuse
+// the U and V of the line above. 12 bits per pixel. The width is even.
+#define VID_YUV_MAX_WIDTH       320
+
+typedef struct VidYuv_State {
+    uint16_t x;                 // next pixel of the line
+    uint16_t y;
+    bool half;                  // second pixel of the last pair is still to be drawn
+    uint8_t half_pixel[2];
+    uint8_t uv[VID_YUV_MAX_WIDTH]; // U, V of each pixel pair, from the last even line
+} VidYuv_State;
+
+// Type 8 (BTC): block truncation coding, 4x4 blocks left to right, top to bottom, each
+// [c0 (RGB565)][c1 (RGB565)][mask (u16)]; mask bit 15 is the top left pixel, row by row, and a set
+// bit draws c1. 6 bytes per 16 pixels, so every frame of a video has the same size. The width and
+// height are multiples of 4.
+#define VID_BTC_BLOCK           4
+#define VID_BTC_BLOCK_LEN       6
+#define VID_BTC_MAX_WIDTH       320
+
+typedef struct VidBtc_State {
+    uint16_t x;                 // next pixel of the line
+    uint16_t y;
+    uint16_t row_loaded;        // bytes of the current block row read
+    uint8_t row[VID_BTC_MAX_WIDTH / VID_BTC_BLOCK * VID_BTC_BLOCK_LEN];
+} VidBtc_State;
+
+// Type 9 (VQ): vector quantization with a codebook of 2x2 patches per frame.
+// [entry_count (u16)][entry_count entries of 4 RGB565 pixels: top left, top right, bottom left,
+// bottom right][one entry index per 2x2 block, left to right, top to bottom].
+// entry_count is 1..256; indices past it are drawn black. The width and height are even.
+#define VID_VQ_BLOCK            2
+#define VID_VQ_ENTRY_LEN        8
+#define VID_VQ_MAX_ENTRIES      256
+#define VID_VQ_MAX_WIDTH        320
+
+typedef struct VidVq_State {
+    uint16_t len;               // codebook entries in the payload, 0 = header not read yet
+    uint16_t loaded;            // codebook bytes read
+    uint16_t x;                 // next pixel of the line
+    uint16_t y;
+    uint16_t row_loaded;        // indices of the current block row read
+    uint8_t row[VID_VQ_MAX_WIDTH / VID_VQ_BLOCK];
+    uint8_t codebook[VID_VQ_MAX_ENTRIES * VID_VQ_ENTRY_LEN] __attribute__((aligned(4)));
+} VidVq_State;
+
+// Type 10 (LZ): LZ4-style sequences over the frame's pixel bytes, for lossless content RLE codes
+// poorly. Each sequence is
+// [token: literal_len << 4 | (match_len - 4)][literal_len - 15 as 255, ..., <255 if it is 15]
+// [literal_len bytes][offset (u16), 1..VID_LZ_WINDOW][match_len - 19 as above if the nibble is 15]
+// and the frame ends after the literals that complete it. Matches reach back at most VID_LZ_WINDOW
+// bytes within the frame, which the decoder keeps, so no frame buffer is needed.
+#define VID_LZ_WINDOW           2048    // power of 2
+#define VID_LZ_MIN_MATCH        4
+
+typedef enum VidLz_Step {
+    VidLz_TOKEN,
+    VidLz_LITERAL_LENGTH,
+    VidLz_LITERALS,
+    VidLz_OFFSET,
+    VidLz_MATCH_LENGTH,
+    VidLz_MATCH,
+} VidLz_Step;
+
+typedef struct VidLz_State {
+    uint8_t step;               // VidLz_Step
+    uint32_t lit_left;          // literal bytes left in the sequence
+    uint32_t match_left;        // match bytes left in the sequence
+    uint16_t offset;
+    uint32_t total;             // bytes produced in the frame
+    uint8_t window[VID_LZ_WINDOW]; // the last VID_LZ_WINDOW bytes produced
+} VidLz_State;
+
+// Type 11 (JPEG): a baseline JPEG image of the frame's size (MJPEG): Huffman coded, 8-bit samples,
+// one interleaved scan of Y or YCbCr, luma sampled 1x1, 2x1, 1x2 or 2x2 against 1x1 chroma, with or
+// without restart markers. The decoder draws each MCU (8x8 to 16x16 pixels, clipped to the frame)
+// as its own rectangle as soon as it is decoded, so it only keeps one MCU and the tables.
+#define VID_JPEG_MAX_BLOCKS     6       // 2x2 luma blocks, Cb, Cr
+#define VID_JPEG_MAX_MCU        16      // MCU width and height in pixels
+#define VID_JPEG_SEGMENT_MAX    20      // longest SOF, SOS or DRI segment body read (3 components)
+
+typedef enum VidJpeg_Step {
+    VidJpeg_MARKER,
+    VidJpeg_LENGTH,
+    VidJpeg_SEGMENT,
+    VidJpeg_SCAN,               // decoding the blocks of an MCU
+    VidJpeg_EMIT,               // drawing the decoded MCU
+    VidJpeg_RESTART,            // expecting a restart marker
+} VidJpeg_Step;
+
+// Huffman table: codes of up to 8 bits by lookup, longer ones by length
+typedef struct VidJpeg_Huff {
+    int32_t maxcode[17];        // largest code of each length, -1 if none
+    int32_t valoff[17];         // index in values of the codes of each length, minus their first code
+    uint16_t lookup[256];       // by the next 8 bits: code length << 8 | value, 0 for longer codes
+    uint8_t values[256];
+} VidJpeg_Huff;
+
+typedef struct VidJpeg_State {
+    uint8_t step;               // VidJpeg_Step
+    uint8_t marker;             // segment being read
+    uint16_t seg_left;          // bytes of the segment not read yet
+    uint16_t seg_pos;           // bytes of the segment (SOF, SOS, DRI) or of the table (DQT, DHT) read
+    uint8_t seg[VID_JPEG_SEGMENT_MAX];
+    uint8_t table;              // DQT, DHT: Pq/Tq or Tc/Th byte of the table being read
+    uint16_t table_len;         // DHT: values in the table
+    uint8_t counts[16];         // DHT: codes of each length
+    bool frame;                 // SOF read
+
+    uint8_t qt[4][64];          // quantization tables, zigzag order
+    VidJpeg_Huff huff[4];       // DC 0, DC 1, AC 0, AC 1
+
+    uint8_t comps;              // 1 (Y) or 3 (YCbCr)
+    uint8_t comp_qt[3];
+    uint8_t comp_dc[3];
+    uint8_t comp_ac[3];
+    uint8_t h;                  // luma blocks per MCU across and down
+    uint8_t v;
+    uint16_t mcus_x;
+    uint16_t mcus_y;
+    uint16_t mcu_x;             // MCU being decoded or drawn
+    uint16_t mcu_y;
+    uint16_t restart_interval;  // MCUs between restart markers, 0 = none
+    uint16_t restart_left;      // MCUs until the next restart marker
+
+    // entropy coded data
+    uint32_t bits;              // left aligned
+    uint8_t count;              // bits buffered
+    bool at_marker;             // the data ends at a marker: zero bits follow
+    int16_t dc[3];              // DC predictions
+    uint8_t block;              // block of the MCU being decoded
+    uint8_t k;                  // next coefficient of the block, zigzag order (0 = DC)
+    int16_t symbol;             // decoded Huffman symbol waiting for its extra bits, -1 = none
+    int32_t coef[64];           // dequantized coefficients, natural order
+
+    uint8_t samples[VID_JPEG_MAX_BLOCKS * 64]; // Y (h * 8 x v * 8), Cb, Cr (8x8)
+    VidRect tile;               // rectangle of the decoded MCU
+    uint32_t emit_pos;          // bytes of tile drawn
+    uint8_t pixels[VID_JPEG_MAX_MCU * VID_JPEG_MAX_MCU * 2] __attribute__((aligned(4)));
+} VidJpeg_State;
+
+typedef struct VidDecoder {
+    uint8_t type;               // VidFrameType
+    uint16_t width;
+    uint16_t height;
+    uint32_t out_remaining;     // output bytes of the frame not produced yet (UINT32_MAX = not known yet)
+    bool rgb444;                // VID_FLAG_RGB444: pixels pass through packed, two in three bytes
+
+    VidRect rect;               // rectangle being produced
+    bool rect_new;              // rect changed; cleared by the caller once it has opened the window
+    bool band_break;            // the last run stopped at the end of a rectangle
+    VidRef* ref;                // motion frames: previous frame, updated as the frame is decoded
+
+    union {
+        VidRle_State rle;
+        VidDelta_State delta;
+        VidMotion_State motion;
+        VidPalette_State palette;
+        VidMono_State mono;
+        VidYuv_State yuv;
+        VidBtc_State btc;
+        VidVq_State vq;
+        VidLz_State lz;
+        VidJpeg_State jpeg;
+    } s;
+} VidDecoder;
+
+// Entropy coded frames (VID_FRAME_ENTROPY): the payload is Huffman coded with the code table of the
+// video (VID_HUFF_TABLE_LEN bytes at the header's table offset) and is decoded ahead of the frame
+// type's decoder. The table holds the code length of each byte value, 4 bits each, high nibble
+// first, 0 for values that do not occur. Codes are canonical (shorter codes first, then by value)
+// and at most VID_HUFF_MAX_BITS long, so one lookup in a 2^VID_HUFF_MAX_BITS entry table gives the
+// value and length of the next code. An entropy coded payload is
+// [payload_len (u32)][codes, MSB first][VID_HUFF_PAD zero bytes].
+#define VID_HUFF_MAX_BITS       10
+#define VID_HUFF_TABLE_LEN      128
+#define VID_HUFF_PAD            2
+
+typedef struct VidHuff_State {
+    uint8_t header_len;         // bytes of payload_len read
+    uint8_t count;              // bits buffered
+    uint32_t bits;              // buffered bits, left aligned
+    uint32_t left;              // payload bytes not decoded yet
+} VidHuff_State;
+
+// Lookup table from the code table; false for invalid code lengths
+bool VidHuff_Build(uint16_t* lookup, const uint8_t* table);
+
+// Decode into out[0..out_cap). Returns the number of bytes produced, or -1 on a corrupt payload.
+// Stops when out is full, the payload is complete or the input runs short (all input consumed).
+int32_t VidHuff_Decode(const uint16_t* lookup, VidHuff_State* st, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+
+// false for frame types that have no decoder, for motion frames without a reference frame
+// of the video's size (`ref` NULL or not holding a frame of this video), and for frame types
+// that produce RGB565 in RGB444 files
+bool VidDecoder_Begin(VidDecoder* dec, uint8_t type, const VidInfo* info, VidRef* ref);
+
+// Decode into out[0..out_cap), out_cap even. Returns the number of bytes produced, or -1 on a
+// corrupt payload. Stops when out is full, the frame is complete or the input runs short.
+int32_t VidDecoder_Run(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+
+int32_t VidRle_Decode(VidRle_State* st, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+int32_t VidDelta_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+int32_t VidMotion_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+int32_t VidI8_Decode(VidPalette_State* st, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+int32_t VidI4_Decode(VidPalette_State* st, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+int32_t VidMono_Decode(VidMono_State* st, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+int32_t VidYuv_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+int32_t VidBtc_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+int32_t VidVq_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+int32_t VidLz_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+int32_t VidJpeg_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap);
+
+// Two RGB565 pixels of luma y0, y1 that share the chroma u, v (centered on 0), in display byte
+// order, as stored by a word store
+uint32_t VidYuv_Pair(uint32_t y0, uint32_t y1, int32_t u, int32_t v);
+
+// Fill with a 2-byte pixel; `out` is 2-byte aligned and len even
+void VidCodec_Fill(uint8_t* out, const uint8_t value[2], uint32_t len);
+
+// Ring line of frame line y (y >= -2 * VID_MOTION_BLOCK)
+static inline uint8_t* VidRef_Line(const VidRef* ref, int32_t y) {
+    return ref->pixels + (uint32_t) ((ref->top + ref->lines + y) % ref->lines) * ref->width * 2;
+}
+
+// Start holding frames of width x height; false if they do not fit the buffer
+bool VidRef_Reset(VidRef* ref, uint16_t width, uint16_t height);
+
+// Copy pixels drawn into `rect`, starting `pos` bytes into it, to the reference frame
+void VidRef_Write(VidRef* ref, const VidRect* rect, uint32_t pos, const uint8_t* src, uint32_t len);
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+
+// Video binary (video.bin) layout, as written by video_converter/video_converter.py.
+// All multi-byte fields are big-endian. See "Video Format" in README.md.
+
+// v1 (legacy): [width][height][num_frames] as u16, then per frame 'FRM' + raw RGB565 pixels
+#define VID_V1_HEADER_LEN       6
+
+// v2: fixed size header starting with a magic. A v1 file starts with the width HB (0x00),
+// so the magic never matches one.
+#define VID_MAGIC               "VID"
+#define VID_MAGIC_LEN           3
+#define VID_VERSION             2
+#define VID_HEADER_LEN          32
+
+// v2 header field offsets
+#define VID_HDR_VERSION         3   // u8
+#define VID_HDR_WIDTH           4   // u16
+#define VID_HDR_HEIGHT          6   // u16
+#define VID_HDR_NUM_FRAMES      8   // u32
+#define VID_HDR_FPS_X100        12  // u16, frames per second * 100 (0 = play as fast as possible)
+#define VID_HDR_FLAGS           14  // u16, VID_FLAG_*
+#define VID_HDR_DATA_OFFSET     16  // u32, file offset of the first frame record
+#define VID_HDR_INDEX_OFFSET    20  // u32, file offset of the frame index (0 = no index)
+#define VID_HDR_TABLE_OFFSET    24  // u32, file offset of the entropy code table (VID_FLAG_ENTROPY)
+// bytes 28..31 reserved (0)
+
+// Frame index: num_frames entries of u32, the file offset of each frame record.
+// Bit 31 of an entry is set for frames that depend on the previous frame (delta frames); playback
+// can only start, seek or skip ahead to a frame with the bit clear (a key frame).
+#define VID_INDEX_ENTRY_LEN     4
+#define VID_INDEX_OFFSET_MASK   0x7FFFFFFFUL
+#define VID_INDEX_DELTA         0x80000000UL
+
+// Header flags
+#define VID_FLAG_ALIGNED        0x0001  // sector-aligned layout, see below
+#define VID_FLAG_MOTION         0x0002  // has motion frames: the player keeps a reference frame
+#define VID_FLAG_RGB444         0x0004  // pixels are RGB444, see below
+#define VID_FLAG_ENTROPY        0x0008  // has entropy coded frames and a code table, see VID_FRAME_ENTROPY
+
+// Sector-aligned layout: the header is padded to one sector and the index starts at
+// VID_SECTOR_SIZE. Index entries are 8 bytes: u32 payload offset, then u32 descriptor
+// (frame type << 24 | payload length). Frame payloads have no 'FRM' header, start on a sector
+// boundary and are zero-padded to a whole number of sectors, so frames are read with FatFs's
+// direct multi-sector path instead of through the FIL sector buffer.
+#define VID_SECTOR_SIZE             512
+#define VID_ALIGNED_INDEX_ENTRY_LEN 8
+#define VID_DESC_TYPE(desc)         ((desc) >> 24)
+#define VID_DESC_LEN(desc)          ((desc) & 0xFFFFFFUL)
+
+// RGB444 files (VID_FLAG_RGB444) hold pixels in the display's 12-bit format, two pixels in three
+// bytes: [R1 G1][B1 R2][G2 B2] (4 bits each), in raster order across line ends. Raw frames and delta
+// rectangles carry (pixels * 3 / 2) bytes, RLE frames code those bytes in 2-byte blocks and LZ
+// frames as they are; the width must be even and other frame types are not allowed.
+
+// Frame record: 'FRM' flag, then (v2 only) frame type and payload length
+#define VID_FRAME_FLAG          "FRM"
+#define VID_FRAME_FLAG_LEN      3
+#define VID_FRAME_HEADER_LEN    8   // 'FRM' + type (u8) + payload length (u32)
+
+// Frame type bit of entropy coded frames: the payload of frame type (type & ~VID_FRAME_ENTROPY) is
+// Huffman coded with the video's code table, see vid_codec.h. Raw frames are never entropy coded.
+#define VID_FRAME_ENTROPY       0x80
+
+typedef enum VidFrameType {
+    VidFrame_RAW = 0,               // RGB565, width * height * 2 bytes
+    VidFrame_RLE = 1,               // RGB565 run-length encoded, see vid_codec.h
+    VidFrame_DELTA = 2,             // changed rectangles since the previous frame, see vid_codec.h
+    VidFrame_MOTION = 3,            // 8x8 blocks copied from the previous frame or raw, see vid_codec.h
+    VidFrame_I8 = 4,                // RGB565 palette and one index byte per pixel, see vid_codec.h
+    VidFrame_I4 = 5,                // 16 color palette and two pixels per byte, see vid_codec.h
+    VidFrame_MONO = 6,              // two colors, one bit per pixel or run lengths, see vid_codec.h
+    VidFrame_YUV420 = 7,            // YCbCr with chroma shared by 2x2 pixels, 12 bits per pixel, see vid_codec.h
+    VidFrame_BTC = 8,               // two colors and a 16-bit mask per 4x4 block, 3 bits per pixel, see vid_codec.h
+    VidFrame_VQ = 9,                // codebook of 2x2 patches and one index per block, see vid_codec.h
+    VidFrame_LZ = 10,               // LZ4-style literals and matches over the pixel bytes, see vid_codec.h
+    VidFrame_JPEG = 11,             // baseline JPEG image, drawn in MCU tiles, see vid_codec.h
+    VidFrame_COUNT
+} VidFrameType;
+
+typedef struct VidInfo {
+    uint8_t version;                // 1 or 2
+    uint16_t width;
+    uint16_t height;
+    uint32_t num_frames;
+    uint16_t fps_x100;
+    uint16_t flags;
+    uint32_t data_offset;           // offset of the first frame record
+    uint32_t index_offset;          // offset of the frame index, 0 if the file has none
+    uint32_t table_offset;          // offset of the entropy code table, 0 if the file has none
+    uint8_t frame_header_len;       // VID_FRAME_FLAG_LEN (v1), VID_FRAME_HEADER_LEN (v2) or 0 (aligned)
+    uint8_t index_entry_len;        // VID_INDEX_ENTRY_LEN or VID_ALIGNED_INDEX_ENTRY_LEN
+} VidInfo;
+
+// bytes of `pixels` pixels in the file's pixel format
+static inline uint32_t Vid_PixelBytes(const VidInfo* info, uint32_t pixels) {
+    return (info->flags & VID_FLAG_RGB444) ? pixels / 2 * 3 : pixels * 2;
+}
+
+static inline uint16_t Vid_ReadU16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t Vid_ReadU32(const uint8_t* p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
@@ -24,7 +24,8 @@
 /* USER CODE BEGIN Includes */
 #include "st7735.h"
 #include "fonts.h"
-#include "sd_playback.h"
+#include "sd_playlist.h"
+#include "playback_profile.h"
 #include "utils.h"
 // #include "testimg.h"
 
@@ -52,10 +53,13 @@ DMA_HandleTypeDef hdma_spi1_tx;
 DMA_HandleTypeDef hdma_spi2_rx;
 DMA_HandleTypeDef hdma_spi2_tx;
 
+TIM_HandleTypeDef htim2;
+
 UART_HandleTypeDef huart2;
 
 /* USER CODE BEGIN PV */
-
+static SDPlaylist playlist;
+static bool sd_mounted = false;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -65,6 +69,7 @@ static void MX_DMA_Init(void);
 static void MX_SPI1_Init(void);
 static void MX_USART2_UART_Init(void);
 static void MX_SPI2_Init(void);
+static void MX_TIM2_Init(void);
 /* USER CODE BEGIN PFP */
 
 /* USER CODE END PFP */
@@ -81,14 +86,42 @@ void init() {
     const char ready[] = "UART Initialized\r\n";
     HAL_UART_Transmit(&huart2, (uint8_t *)ready, sizeof(ready) - 1, HAL_MAX_DELAY);
 
-    FRESULT res = SDPlayback_Begin();
+    FRESULT res = SDPlayback_Mount();
+    if(res == FR_OK) {
+      sd_mounted = true;
+
+      // one-time calibration pass for the converter's cost model, see playback_profile.h;
+      // the playlist's first player is free until SDPlaylist_Open
+      static PlaybackProfile profile;
+      if(PlaybackProfile_Pending())
+        PlaybackProfile_Calibrate(&playlist.players[0], &profile);
+
+      // every .bin file in /vid, back to back, looping
+      res = SDPlaylist_Open(&playlist, SDPLAYLIST_DIR, true);
+    }
+
     if(res != FR_OK)
       myprintf("Error occurred during video playback");
-    
-    SDPlayback_Unmount();
 }
 
 void loop() {
+    // advance playback by at most one band; the rest of the loop runs between transfers
+    SDPlayback_State state = SDPlaylist_Poll(&playlist);
+
+    if(state == SDPlayback_FINISHED || state == SDPlayback_ERROR) {
+      if(state == SDPlayback_ERROR)
+        myprintf("Error occurred during video playback");
+
+      myprintf("Dropped %lu frames\r\n", playlist.dropped_frames);
+      PlaybackStats_Print(&playlist.stats);
+      SDPlaylist_Close(&playlist);
+    }
+
+    if(sd_mounted && playlist.state == SDPlayback_CLOSED) {
+      SDPlayback_Unmount();
+      sd_mounted = false;
+    }
+
     // ST7735_DrawImage(0, 0, 128, 128, test_img_128x128);
     // ST7735_WriteString(10, 140, "<3 aquila", Font_11x18, ST7735_RED,
     //                    ST7735_BLACK);
@@ -131,6 +164,7 @@ int main(void)
   MX_USART2_UART_Init();
   MX_SPI2_Init();
   MX_FATFS_Init();
+  MX_TIM2_Init();
   /* USER CODE BEGIN 2 */
   init();
 
@@ -142,7 +176,7 @@ int main(void)
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
-        // loop();
+        loop();
   }
   /* USER CODE END 3 */
 }
@@ -269,6 +303,51 @@ static void MX_SPI2_Init(void)
 
 }
 
+/**
+  * @brief TIM2 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM2_Init(void)
+{
+
+  /* USER CODE BEGIN TIM2_Init 0 */
+
+  /* USER CODE END TIM2_Init 0 */
+
+  TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM2_Init 1 */
+
+  /* USER CODE END TIM2_Init 1 */
+  htim2.Instance = TIM2;
+  htim2.Init.Prescaler = 84-1;
+  htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim2.Init.Period = 4294967295;
+  htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+  if (HAL_TIM_ConfigClockSource(&htim2, &sClockSourceConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim2, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM2_Init 2 */
+
+  /* USER CODE END TIM2_Init 2 */
+
+}
+
 /**
   * @brief USART2 Initialization Function
   * @param None
@@ -0,0 +1,22 @@
+#include "playback_clock.h"
+
+void PlaybackClock_Start(void) {
+    HAL_TIM_Base_Start(&PLAYBACK_CLOCK_TIM);
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t PlaybackClock_Micros(void) {
+    return __HAL_TIM_GET_COUNTER(&PLAYBACK_CLOCK_TIM);
+}
+
+uint32_t PlaybackClock_Cycles(void) {
+    return DWT->CYCCNT;
+}
+
+void PlaybackClock_WaitUntil(uint32_t deadline_us) {
+    // signed difference handles the counter wrap
+    while((int32_t) (deadline_us - PlaybackClock_Micros()) > 0);
+}
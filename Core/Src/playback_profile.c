@@ -0,0 +1,117 @@
+#include <stm32f4xx_hal.h>
+#include <string.h>
+
+#include "playback_profile.h"
+#include "playback_clock.h"
+#include "st7735.h"
+#include "utils.h"
+
+bool PlaybackProfile_Pending(void) {
+    FILINFO fno;
+    return f_stat(PLAYBACK_PROFILE_CALIB_PATH, &fno) == FR_OK && f_stat(PLAYBACK_PROFILE_PATH, &fno) == FR_NO_FILE;
+}
+
+// Stream one full screen of `band` through a single window, then open small windows: their time
+// beyond the pixel bytes is the cost of a window. Both use the player's path (ST7735_WriteAsync).
+static void PlaybackProfile_MeasureDisplay(PlaybackProfile* profile, const uint8_t* band, uint32_t band_len) {
+    uint32_t screen_bytes = ST7735_WIDTH * ST7735_HEIGHT * 2;
+
+    uint32_t start_us = PlaybackClock_Micros();
+    ST7735_BeginWrite(0, 0, ST7735_WIDTH, ST7735_HEIGHT);
+    for(uint32_t sent = 0; sent < screen_bytes; sent += band_len)
+        ST7735_WriteAsync(band, (screen_bytes - sent < band_len) ? screen_bytes - sent : band_len);
+    ST7735_WaitDrawImage();
+    uint32_t elapsed_us = PlaybackClock_Micros() - start_us;
+    profile->display_bytes_per_ms = (uint64_t) screen_bytes * 1000 / elapsed_us;
+
+    start_us = PlaybackClock_Micros();
+    for(uint32_t i = 0; i < PLAYBACK_PROFILE_WINDOWS; i++) {
+        ST7735_BeginWrite(i * 8 % ST7735_WIDTH, i * 8 / ST7735_WIDTH * 8, 8, 8);
+        ST7735_WriteAsync(band, 8 * 8 * 2);
+    }
+    ST7735_WaitDrawImage();
+    elapsed_us = PlaybackClock_Micros() - start_us;
+
+    uint32_t pixels_us = (uint64_t) PLAYBACK_PROFILE_WINDOWS * 8 * 8 * 2 * 1000 / profile->display_bytes_per_ms;
+    profile->window_us = (elapsed_us > pixels_us) ? (elapsed_us - pixels_us) / PLAYBACK_PROFILE_WINDOWS : 0;
+}
+
+static void PlaybackProfile_FromStats(PlaybackProfile* profile, const PlaybackStats* stats) {
+    if(stats->read.sum_us > 0)
+        profile->sd_bytes_per_ms = stats->read_bytes * 1000 / stats->read.sum_us;
+
+    for(int i = 0; i < VidFrame_COUNT; i++) {
+        if(stats->decode_pixels[i] > 0)
+            profile->decode_cycles_x100[i] = stats->decode_cycles[i] * 100 / stats->decode_pixels[i];
+    }
+
+    if(stats->entropy_bytes > 0)
+        profile->entropy_cycles_x100 = stats->entropy_cycles * 100 / stats->entropy_bytes;
+}
+
+FRESULT PlaybackProfile_Calibrate(SDPlayback* player, PlaybackProfile* profile) {
+    FRESULT fres;
+
+    memset(profile, 0, sizeof(*profile));
+    profile->cpu_hz = SystemCoreClock;
+
+    // a black screen from a cleared band
+    memset(player->bands[0], 0, SDPLAYBACK_BAND_SIZE);
+    PlaybackProfile_MeasureDisplay(profile, player->bands[0], SDPLAYBACK_BAND_SIZE);
+
+    fres = SDPlayback_Open(player, PLAYBACK_PROFILE_CALIB_PATH);
+    if(fres != FR_OK)
+        return fres;
+
+    if(player->info.fps_x100 != 0)
+        myprintf("Calibration video is paced, dropped frames are not measured\r\n");
+
+    SDPlayback_Play(player);
+    while(SDPlayback_Poll(player) == SDPlayback_PLAYING);
+
+    fres = (player->state == SDPlayback_ERROR) ? player->error : FR_OK;
+    if(fres == FR_OK)
+        PlaybackProfile_FromStats(profile, &player->stats);
+    SDPlayback_Close(player);
+
+    if(fres != FR_OK) {
+        myprintf("Calibration video failed (%d)\r\n", fres);
+        return fres;
+    }
+
+    fres = PlaybackProfile_Write(profile, PLAYBACK_PROFILE_PATH);
+    if(fres != FR_OK)
+        myprintf("Failed to write %s (%d)\r\n", PLAYBACK_PROFILE_PATH, fres);
+    else
+        myprintf("Wrote %s: SD %lu bytes/ms, display %lu bytes/ms, window %lu us\r\n", PLAYBACK_PROFILE_PATH,
+                 profile->sd_bytes_per_ms, profile->display_bytes_per_ms, profile->window_us);
+    return fres;
+}
+
+FRESULT PlaybackProfile_Write(const PlaybackProfile* profile, const char* path) {
+    FIL file;
+    FRESULT fres;
+    bool ok = true;
+
+    fres = f_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS);
+    if(fres != FR_OK)
+        return fres;
+
+    ok &= f_printf(&file, "cpu_hz %lu\n", profile->cpu_hz) >= 0;
+    ok &= f_printf(&file, "sd_bytes_per_ms %lu\n", profile->sd_bytes_per_ms) >= 0;
+    ok &= f_printf(&file, "display_bytes_per_ms %lu\n", profile->display_bytes_per_ms) >= 0;
+    ok &= f_printf(&file, "window_us %lu\n", profile->window_us) >= 0;
+
+    for(int i = 0; i < VidFrame_COUNT; i++) {
+        uint32_t cpp100 = profile->decode_cycles_x100[i];
+        if(cpp100 != 0)
+            ok &= f_printf(&file, "decode %d %lu.%02lu\n", i, cpp100 / 100, cpp100 % 100) >= 0;
+    }
+
+    if(profile->entropy_cycles_x100 != 0)
+        ok &= f_printf(&file, "entropy %lu.%02lu\n", profile->entropy_cycles_x100 / 100,
+                       profile->entropy_cycles_x100 % 100) >= 0;
+
+    fres = f_close(&file);
+    return (fres == FR_OK && !ok) ? FR_DISK_ERR : fres;
+}
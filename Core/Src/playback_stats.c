@@ -0,0 +1,153 @@
+#include <string.h>
+
+#include "playback_stats.h"
+#include "utils.h"
+
+static void PlaybackHistogram_Reset(PlaybackHistogram* hist) {
+    memset(hist, 0, sizeof(*hist));
+    hist->min_us = UINT32_MAX;
+}
+
+static void PlaybackHistogram_Add(PlaybackHistogram* hist, uint32_t us) {
+    uint32_t bucket = us / PLAYBACK_STATS_BUCKET_US;
+    if(bucket >= PLAYBACK_STATS_BUCKETS)
+        bucket = PLAYBACK_STATS_BUCKETS - 1;
+
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->sum_us += us;
+
+    if(us < hist->min_us)
+        hist->min_us = us;
+    if(us > hist->max_us)
+        hist->max_us = us;
+}
+
+static void PlaybackHistogram_Merge(PlaybackHistogram* dst, const PlaybackHistogram* src) {
+    if(src->count == 0)
+        return;
+
+    for(int i = 0; i < PLAYBACK_STATS_BUCKETS; i++)
+        dst->buckets[i] += src->buckets[i];
+
+    dst->count += src->count;
+    dst->sum_us += src->sum_us;
+
+    if(src->min_us < dst->min_us)
+        dst->min_us = src->min_us;
+    if(src->max_us > dst->max_us)
+        dst->max_us = src->max_us;
+}
+
+uint32_t PlaybackHistogram_Percentile(const PlaybackHistogram* hist, uint32_t percent) {
+    if(hist->count == 0)
+        return 0;
+
+    // rank of the sample at `percent`, rounded up (nearest-rank method)
+    uint32_t rank = ((uint64_t) hist->count * percent + 99) / 100;
+    if(rank == 0)
+        rank = 1;
+
+    uint32_t seen = 0;
+    for(int i = 0; i < PLAYBACK_STATS_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if(seen >= rank) {
+            uint32_t upper_us = (i + 1) * PLAYBACK_STATS_BUCKET_US;
+            return (upper_us < hist->max_us) ? upper_us : hist->max_us;
+        }
+    }
+
+    return hist->max_us;
+}
+
+void PlaybackStats_Reset(PlaybackStats* stats) {
+    PlaybackHistogram_Reset(&stats->read);
+    PlaybackHistogram_Reset(&stats->draw);
+    PlaybackHistogram_Reset(&stats->total);
+    stats->read_bytes = 0;
+    memset(stats->decode_cycles, 0, sizeof(stats->decode_cycles));
+    memset(stats->decode_pixels, 0, sizeof(stats->decode_pixels));
+    stats->entropy_frames = stats->entropy_max_cycles = 0;
+    stats->entropy_cycles = stats->entropy_bytes = 0;
+}
+
+void PlaybackStats_Record(PlaybackStats* stats, uint32_t read_us, uint32_t read_bytes, uint32_t draw_us,
+                          uint32_t total_us) {
+    PlaybackHistogram_Add(&stats->read, read_us);
+    stats->read_bytes += read_bytes;
+    PlaybackHistogram_Add(&stats->draw, draw_us);
+    PlaybackHistogram_Add(&stats->total, total_us);
+}
+
+void PlaybackStats_RecordDecode(PlaybackStats* stats, uint8_t frame_type, uint32_t cycles, uint32_t pixels) {
+    if(frame_type >= VidFrame_COUNT)
+        return;
+
+    stats->decode_cycles[frame_type] += cycles;
+    stats->decode_pixels[frame_type] += pixels;
+}
+
+void PlaybackStats_RecordEntropy(PlaybackStats* stats, uint32_t cycles, uint32_t bytes) {
+    stats->entropy_frames++;
+    stats->entropy_cycles += cycles;
+    stats->entropy_bytes += bytes;
+    if(cycles > stats->entropy_max_cycles)
+        stats->entropy_max_cycles = cycles;
+}
+
+void PlaybackStats_Merge(PlaybackStats* dst, const PlaybackStats* src) {
+    PlaybackHistogram_Merge(&dst->read, &src->read);
+    PlaybackHistogram_Merge(&dst->draw, &src->draw);
+    PlaybackHistogram_Merge(&dst->total, &src->total);
+    dst->read_bytes += src->read_bytes;
+
+    for(int i = 0; i < VidFrame_COUNT; i++) {
+        dst->decode_cycles[i] += src->decode_cycles[i];
+        dst->decode_pixels[i] += src->decode_pixels[i];
+    }
+
+    dst->entropy_frames += src->entropy_frames;
+    dst->entropy_cycles += src->entropy_cycles;
+    dst->entropy_bytes += src->entropy_bytes;
+    if(src->entropy_max_cycles > dst->entropy_max_cycles)
+        dst->entropy_max_cycles = src->entropy_max_cycles;
+}
+
+static void PlaybackHistogram_Print(const char* name, const PlaybackHistogram* hist) {
+    if(hist->count == 0) {
+        myprintf("%-5s n=0\r\n", name);
+        return;
+    }
+
+    myprintf("%-5s n=%lu min=%lu mean=%lu p50=%lu p90=%lu p99=%lu max=%lu us\r\n", name,
+             hist->count, hist->min_us, (uint32_t) (hist->sum_us / hist->count),
+             PlaybackHistogram_Percentile(hist, 50), PlaybackHistogram_Percentile(hist, 90),
+             PlaybackHistogram_Percentile(hist, 99), hist->max_us);
+}
+
+void PlaybackStats_Print(const PlaybackStats* stats) {
+    PlaybackHistogram_Print("read", &stats->read);
+    PlaybackHistogram_Print("draw", &stats->draw);
+    PlaybackHistogram_Print("total", &stats->total);
+
+    if(stats->read.sum_us > 0)
+        myprintf("sd read bytes=%lu KB/s=%lu\r\n", (uint32_t) stats->read_bytes,
+                 (uint32_t) (stats->read_bytes * 1000000 / stats->read.sum_us / 1024));
+
+    for(int i = 0; i < VidFrame_COUNT; i++) {
+        if(stats->decode_pixels[i] == 0)
+            continue;
+
+        // cycles per pixel with two decimals
+        uint32_t cpp100 = (uint32_t) (stats->decode_cycles[i] * 100 / stats->decode_pixels[i]);
+        myprintf("decode type=%d px=%lu cycles/px=%lu.%02lu\r\n", i, stats->decode_pixels[i],
+                 cpp100 / 100, cpp100 % 100);
+    }
+
+    if(stats->entropy_frames > 0) {
+        uint32_t cpb100 = (uint32_t) (stats->entropy_cycles * 100 / stats->entropy_bytes);
+        myprintf("entropy frames=%lu cycles/frame mean=%lu max=%lu cycles/byte=%lu.%02lu\r\n",
+                 stats->entropy_frames, (uint32_t) (stats->entropy_cycles / stats->entropy_frames),
+                 stats->entropy_max_cycles, cpb100 / 100, cpb100 % 100);
+    }
+}
@@ -2,41 +2,31 @@
 #include <string.h>
 
 #include "sd_playback.h"
+#include "user_diskio_spi.h"
 #include "st7735.h"
 #include "utils.h"
+#include "playback_clock.h"
 
-#define VID_BIN_PATH "/vid/video.bin"
-#define ENABLE_LOG   1
-#define IFLOG        if(ENABLE_LOG)
+_Static_assert(SDPLAYBACK_BAND_SIZE % VID_SECTOR_SIZE == 0, "SDPLAYBACK_BAND_SIZE must be a multiple of the sector size");
 
-typedef enum DebugTimer_Arg {
-    DebugTimer_START,
-    DebugTimer_END,
-} DebugTimer_Arg;
+// per-frame timings into player->stats (see playback_stats.h); replaces per-frame UART logging
+#define ENABLE_STATS 1
+#define IFSTATS      if(ENABLE_STATS)
 
-// return measured time in milliseconds (ms)
-static uint32_t DebugTimer_MeasureTime(DebugTimer_Arg arg) {
-    static uint32_t start_time = 0;
-    static uint32_t end_time = 0;
+// file system object shared by all players; valid between SDPlayback_Mount() and SDPlayback_Unmount()
+static FATFS FatFs;
 
-    if(arg == DebugTimer_START) {
-        start_time = HAL_GetTick();
-    }
-    
-    if(arg == DebugTimer_END) {
-        end_time = HAL_GetTick();
-        return (end_time - start_time);
-    }
+#if SDPLAYBACK_REF_FRAME
+// previous frame for motion frames (see vid_codec.h), sized for a full screen video
+static uint8_t RefPixels[ST7735_WIDTH * VID_REF_LINES(ST7735_HEIGHT) * 2] __attribute__((aligned(4)));
+static VidRef RefFrame = { .pixels = RefPixels, .size = sizeof(RefPixels) };
+#endif
 
-    return 0;
-}
-
-FRESULT SDPlayback_Begin() {
+FRESULT SDPlayback_Mount(void) {
     myprintf("\r\n~ SD card Initialize ~\r\n\r\n");
 
     HAL_Delay(500); // delay before initialization
 
-    FATFS FatFs;
     FRESULT fres;
 
     // mount the file system
@@ -61,87 +51,967 @@ FRESULT SDPlayback_Begin() {
     free_sectors = free_clusters * getFreeFs->csize;
     myprintf("SD card stats:\r\n%10lu KiB total drive space.\r\n%10lu KiB available.\r\n", total_sectors / 2, free_sectors / 2);
 
-    // ------------------- VIDEO PLAYBACK -----------------------------
-    FIL file;
-    const char* vid_path = VID_BIN_PATH;
-    fres = f_open(&file, vid_path, FA_READ);
-    
+    PlaybackClock_Start();
+
+    return FR_OK;
+}
+
+void SDPlayback_Unmount() {
+    f_mount(NULL, "", 0);
+}
+
+// Parse a v1 or v2 header at the start of the file. Leaves the file positioned at the first frame.
+static FRESULT SDPlayback_ReadHeader(FIL* file, VidInfo* info) {
+    BYTE header[VID_HEADER_LEN];
+    UINT bytes_read;
+    FRESULT fres;
+
+    fres = f_read(file, header, VID_V1_HEADER_LEN, &bytes_read);
+    if(fres != FR_OK || bytes_read != VID_V1_HEADER_LEN)
+        return (fres != FR_OK) ? fres : FR_INVALID_OBJECT;
+
+    if(memcmp(header, VID_MAGIC, VID_MAGIC_LEN) != 0) {
+        // v1: no frame rate, frames follow the header directly
+        info->version = 1;
+        info->width = Vid_ReadU16(&header[0]);
+        info->height = Vid_ReadU16(&header[2]);
+        info->num_frames = Vid_ReadU16(&header[4]);
+        info->fps_x100 = 0;
+        info->flags = 0;
+        info->data_offset = VID_V1_HEADER_LEN;
+        info->index_offset = 0;
+        info->table_offset = 0;
+        info->frame_header_len = VID_FRAME_FLAG_LEN;
+        info->index_entry_len = 0;
+        return FR_OK;
+    }
+
+    fres = f_read(file, header + VID_V1_HEADER_LEN, VID_HEADER_LEN - VID_V1_HEADER_LEN, &bytes_read);
+    if(fres != FR_OK || bytes_read != VID_HEADER_LEN - VID_V1_HEADER_LEN)
+        return (fres != FR_OK) ? fres : FR_INVALID_OBJECT;
+
+    if(header[VID_HDR_VERSION] != VID_VERSION) {
+        myprintf("Unsupported video version %d\r\n", header[VID_HDR_VERSION]);
+        return FR_INVALID_OBJECT;
+    }
+
+    info->version = header[VID_HDR_VERSION];
+    info->width = Vid_ReadU16(&header[VID_HDR_WIDTH]);
+    info->height = Vid_ReadU16(&header[VID_HDR_HEIGHT]);
+    info->num_frames = Vid_ReadU32(&header[VID_HDR_NUM_FRAMES]);
+    info->fps_x100 = Vid_ReadU16(&header[VID_HDR_FPS_X100]);
+    info->flags = Vid_ReadU16(&header[VID_HDR_FLAGS]);
+    info->data_offset = Vid_ReadU32(&header[VID_HDR_DATA_OFFSET]);
+    info->index_offset = Vid_ReadU32(&header[VID_HDR_INDEX_OFFSET]);
+    info->table_offset = Vid_ReadU32(&header[VID_HDR_TABLE_OFFSET]);
+    info->frame_header_len = VID_FRAME_HEADER_LEN;
+    info->index_entry_len = VID_INDEX_ENTRY_LEN;
+
+    if(info->flags & VID_FLAG_ALIGNED) {
+        // frames are described by the index only
+        if(info->index_offset == 0 || info->data_offset % VID_SECTOR_SIZE != 0) {
+            myprintf("Invalid sector-aligned layout\r\n");
+            return FR_INVALID_OBJECT;
+        }
+
+        info->frame_header_len = 0;
+        info->index_entry_len = VID_ALIGNED_INDEX_ENTRY_LEN;
+    }
+
+    return f_lseek(file, info->data_offset);
+}
+
+// Build the entropy decoder's lookup table from the file's code table; the file stays at the first frame
+static FRESULT SDPlayback_ReadCodeTable(FIL* file, const VidInfo* info, uint16_t* lookup) {
+    BYTE table[VID_HUFF_TABLE_LEN];
+    UINT bytes_read;
+    FRESULT fres;
+
+    if(info->table_offset == 0)
+        return FR_INVALID_OBJECT;
+
+    fres = f_lseek(file, info->table_offset);
+    if(fres == FR_OK)
+        fres = f_read(file, table, VID_HUFF_TABLE_LEN, &bytes_read);
+    if(fres != FR_OK || bytes_read != VID_HUFF_TABLE_LEN)
+        return (fres != FR_OK) ? fres : FR_INVALID_OBJECT;
+
+    if(!VidHuff_Build(lookup, table))
+        return FR_INVALID_OBJECT;
+
+    return f_lseek(file, info->data_offset);
+}
+
+static uint32_t SDPlayback_FrameBytes(const VidInfo* info) {
+    return Vid_PixelBytes(info, (uint32_t) info->width * info->height);
+}
+
+// File access for the playback hot path. A contiguous file is read at absolute sectors in an
+// SD stream session (player->lba != 0) and the position is tracked here; otherwise this is plain FatFs.
+static FSIZE_t SDPlayback_FileTell(SDPlayback* player) {
+    return (player->lba != 0) ? player->lba_pos : f_tell(&player->file);
+}
+
+static FRESULT SDPlayback_FileSeek(SDPlayback* player, FSIZE_t offset) {
+    if(player->lba != 0) {
+        player->lba_pos = offset;
+        return FR_OK;
+    }
+
+    return f_lseek(&player->file, offset);
+}
+
+// Read exactly `len` bytes. In raw LBA mode, position and length must be whole sectors (aligned layout).
+static FRESULT SDPlayback_FileRead(SDPlayback* player, void* buff, UINT len) {
+    if(player->lba != 0) {
+        if(player->lba_pos % VID_SECTOR_SIZE != 0 || len % VID_SECTOR_SIZE != 0)
+            return FR_INT_ERR;
+
+        if(player->lba_pos + len > f_size(&player->file))
+            return FR_INVALID_OBJECT;
+
+        // sequential reads continue the open CMD18 session; a seek restarts it
+        DWORD sector = player->lba + player->lba_pos / VID_SECTOR_SIZE;
+        if(USER_SPI_StreamRead(player->file.obj.fs->drv, buff, sector, len / VID_SECTOR_SIZE) != RES_OK)
+            return FR_DISK_ERR;
+
+        player->lba_pos += len;
+        return FR_OK;
+    }
+
+    UINT bytes_read;
+    FRESULT fres = f_read(&player->file, buff, len, &bytes_read);
+    if(fres == FR_OK && bytes_read != len)
+        fres = FR_INVALID_OBJECT;
+
+    return fres;
+}
+
+// Index entry of `frame`, through a one-sector cache so sequential playback of an aligned file
+// reads the index once every VID_SECTOR_SIZE / entry length frames. Moves the file pointer on a miss.
+static FRESULT SDPlayback_IndexEntry(SDPlayback* player, uint32_t frame, const uint8_t** entry) {
+    const VidInfo* info = &player->info;
+    uint32_t entries_per_block = VID_SECTOR_SIZE / info->index_entry_len;
+    uint32_t block = frame / entries_per_block;
+
+    if(block != player->index_block) {
+        uint32_t block_entries = info->num_frames - block * entries_per_block;
+        if(block_entries > entries_per_block)
+            block_entries = entries_per_block;
+
+        UINT block_len = block_entries * info->index_entry_len;
+        FRESULT fres;
+
+        // raw LBA reads whole sectors; the aligned index is padded to one
+        if(player->lba != 0)
+            block_len = VID_SECTOR_SIZE;
+
+        player->index_block = UINT32_MAX;
+
+        fres = SDPlayback_FileSeek(player, info->index_offset + block * VID_SECTOR_SIZE);
+        if(fres != FR_OK)
+            return fres;
+
+        fres = SDPlayback_FileRead(player, player->index_cache, block_len);
+        if(fres != FR_OK)
+            return fres;
+
+        player->index_block = block;
+    }
+
+    *entry = &player->index_cache[(frame % entries_per_block) * info->index_entry_len];
+    return FR_OK;
+}
+
+// File offset of a frame record: looked up in the frame index when the file has one,
+// otherwise computed from the fixed raw record size
+static FRESULT SDPlayback_FrameOffset(SDPlayback* player, uint32_t frame, FSIZE_t* offset) {
+    const VidInfo* info = &player->info;
+
+    if(info->index_offset == 0) {
+        FSIZE_t record_len = info->frame_header_len + SDPlayback_FrameBytes(info);
+        *offset = info->data_offset + frame * record_len;
+        return FR_OK;
+    }
+
+    const uint8_t* entry;
+    FRESULT fres = SDPlayback_IndexEntry(player, frame, &entry);
+    if(fres != FR_OK)
+        return fres;
+
+    *offset = Vid_ReadU32(entry) & VID_INDEX_OFFSET_MASK;
+    return FR_OK;
+}
+
+// Latest key frame in [first, frame]; `first` when there is none. Files without an index have no
+// delta frames. Moves the file pointer when it reads the index.
+static FRESULT SDPlayback_FindKeyFrame(SDPlayback* player, uint32_t frame, uint32_t first, uint32_t* key) {
+    if(player->info.index_offset != 0) {
+        for(; frame > first; frame--) {
+            const uint8_t* entry;
+            FRESULT fres = SDPlayback_IndexEntry(player, frame, &entry);
+            if(fres != FR_OK)
+                return fres;
+
+            if(!(Vid_ReadU32(entry) & VID_INDEX_DELTA))
+                break;
+        }
+    }
+
+    *key = frame;
+    return FR_OK;
+}
+
+// Build the cluster link map table so f_lseek() no longer walks the FAT chain
+static void SDPlayback_EnableFastSeek(SDPlayback* player) {
+    player->clmt[0] = SDPLAYBACK_CLMT_LEN;
+    player->file.cltbl = player->clmt;
+
+    FRESULT fres = f_lseek(&player->file, CREATE_LINKMAP);
     if(fres != FR_OK) {
-        myprintf("Failed to open %s. f_open error (%i)\r\n", vid_path, fres);
+        // FR_NOT_ENOUGH_CORE: too fragmented for the table (clmt[0] holds the required length)
+        myprintf("Fast seek disabled (%d), needs %lu CLMT items\r\n", fres, player->clmt[0]);
+        player->file.cltbl = NULL;
+    }
+}
 
-        f_close(&file);
+// Raw LBA mode: if the file is one contiguous run of clusters (a single fast seek fragment),
+// resolve its first sector once and read frames in an SD stream session, bypassing FatFs entirely.
+// Needs the sector-aligned layout; fragmented or packed files keep using f_read().
+static void SDPlayback_EnableRawLBA(SDPlayback* player) {
+    FATFS* fs = player->file.obj.fs;
+
+    if(!(player->info.flags & VID_FLAG_ALIGNED) || player->file.cltbl == NULL)
+        return;
+
+    // CLMT of a contiguous file: [4][cluster count][first cluster][0]
+    if(player->clmt[0] != 4) {
+        myprintf("Raw LBA disabled, file is fragmented (%lu CLMT items)\r\n", player->clmt[0]);
+        return;
+    }
+
+    player->lba = fs->database + (player->clmt[2] - 2) * fs->csize;
+    player->lba_pos = f_tell(&player->file);
+    myprintf("Raw LBA enabled, file starts at sector %lu\r\n", player->lba);
+}
+
+// Presentation time of `frame` relative to the start of playback
+static uint32_t SDPlayback_FrameTime(const VidInfo* info, uint32_t frame) {
+    return (uint64_t) frame * 100000000ULL / info->fps_x100;
+}
+
+// Close this player's RAMWR window, if it has one. Another player may own the display
+// (playlist preroll), so players never close a window they did not open.
+static void SDPlayback_ReleaseDisplay(SDPlayback* player) {
+    if(!player->drawing)
+        return;
+
+    ST7735_WaitDrawImage();
+    player->drawing = false;
+}
+
+// More of the current frame is still to be read or decoded
+static bool SDPlayback_FrameLoaded(const SDPlayback* player) {
+    return player->frame_remaining > 0 || player->dec.out_remaining > 0;
+}
+
+static bool SDPlayback_FrameInProgress(const SDPlayback* player) {
+    return SDPlayback_FrameLoaded(player) || player->band_pending != NULL;
+}
+
+// Drop the rest of the current frame
+static void SDPlayback_AbortFrame(SDPlayback* player) {
+    player->band_pending = NULL;
+    player->out_band = NULL;
+    player->frame_remaining = 0;
+    player->dec.out_remaining = 0;
+    player->in_pos = player->in_len = 0;
+    player->coded_pos = player->coded_len = 0;
+}
+
+static void SDPlayback_Fail(SDPlayback* player, FRESULT fres) {
+    SDPlayback_ReleaseDisplay(player);
+    SDPlayback_AbortFrame(player);
+    player->error = fres;
+    player->state = SDPlayback_ERROR;
+}
+
+FRESULT SDPlayback_Open(SDPlayback* player, const char* path) {
+    FRESULT fres;
+
+    memset(player, 0, sizeof(*player));
+    player->state = SDPlayback_CLOSED;
+    player->index_block = UINT32_MAX;
+    PlaybackStats_Reset(&player->stats);
+
+    fres = f_open(&player->file, path, FA_READ);
+    if(fres != FR_OK) {
+        myprintf("Failed to open %s. f_open error (%i)\r\n", path, fres);
         return fres;
+    }
+
+    myprintf("Opened %s for reading!\r\n", path);
+
+    SDPlayback_EnableFastSeek(player);
+
+    VidInfo* info = &player->info;
+    fres = SDPlayback_ReadHeader(&player->file, info);
+    if(fres != FR_OK) {
+        myprintf("Failed to read header. f_read error (%d)\r\n", fres);
+        f_close(&player->file);
+        return fres;
+    }
+
+    if(info->flags & VID_FLAG_ENTROPY) {
+        fres = SDPlayback_ReadCodeTable(&player->file, info, player->huff_lookup);
+        if(fres != FR_OK) {
+            myprintf("Failed to read entropy code table (%d)\r\n", fres);
+            f_close(&player->file);
+            return fres;
+        }
+    }
+
+    SDPlayback_EnableRawLBA(player);
+
+    // 12-bit windows need an even number of pixels; the reference frame holds RGB565
+    if((info->flags & VID_FLAG_RGB444) && (info->width % 2 != 0 || (info->flags & VID_FLAG_MOTION))) {
+        myprintf("Invalid RGB444 video %dx%d, flags %04x\r\n", info->width, info->height, info->flags);
+        f_close(&player->file);
+        return FR_INVALID_OBJECT;
+    }
+
+    if(info->flags & VID_FLAG_MOTION) {
+#if SDPLAYBACK_REF_FRAME
+        // checks the size only, the reference is set up by the first key frame drawn
+        VidRef check = { .size = RefFrame.size };
+        if(VidRef_Reset(&check, info->width, info->height))
+            player->ref = &RefFrame;
+#endif
+        if(player->ref == NULL) {
+            myprintf("No reference frame for motion frames of %dx%d\r\n", info->width, info->height);
+            f_close(&player->file);
+            return FR_INVALID_OBJECT;
+        }
+    }
+
+    myprintf("Read header from %s. v%d %dx%d, %lu frames, %d.%02d fps\r\n", path, info->version,
+             info->width, info->height, info->num_frames, info->fps_x100 / 100, info->fps_x100 % 100);
+
+    player->state = SDPlayback_READY;
+    return FR_OK;
+}
+
+// Index of the frame on screen or being streamed: a loaded frame has already advanced player->frame
+static uint32_t SDPlayback_CurrentFrame(const SDPlayback* player) {
+    return player->frame - (SDPlayback_FrameInProgress(player) ? 1 : 0);
+}
+
+void SDPlayback_PlayAt(SDPlayback* player, uint32_t due_us) {
+    if(player->state == SDPlayback_READY) {
+        player->start_us = due_us - SDPlayback_FrameTime(&player->info, SDPlayback_CurrentFrame(player));
+        // a prerolled frame was loaded ahead of time; time it from the start of playback
+        player->frame_start_us = due_us;
+    } else if(player->state == SDPlayback_PAUSED) {
+        // the clock does not advance while paused
+        player->start_us += due_us - player->pause_us;
     } else {
-        myprintf("Opened %s for reading!\r\n", vid_path);
+        return;
     }
 
-    // Read header
-    BYTE header[6];
-    UINT bytes_read;
-    
-    fres = f_read(&file, header, sizeof(header), &bytes_read);
+    player->refresh = false;
+    player->state = SDPlayback_PLAYING;
+}
+
+void SDPlayback_Play(SDPlayback* player) {
+    SDPlayback_PlayAt(player, PlaybackClock_Micros());
+}
+
+uint32_t SDPlayback_EndTime(const SDPlayback* player) {
+    if(player->info.fps_x100 == 0)
+        return PlaybackClock_Micros();
+
+    return player->start_us + SDPlayback_FrameTime(&player->info, player->info.num_frames);
+}
+
+// Takes effect at the next frame boundary: the frame being streamed is completed by SDPlayback_Poll()
+void SDPlayback_Pause(SDPlayback* player) {
+    if(player->state != SDPlayback_PLAYING)
+        return;
+
+    player->pause_us = PlaybackClock_Micros();
+    player->state = SDPlayback_PAUSED;
+}
+
+static FRESULT SDPlayback_SeekFile(SDPlayback* player, uint32_t frame) {
+    FSIZE_t offset;
+    FRESULT fres;
+
+    fres = SDPlayback_FrameOffset(player, frame, &offset);
+    if(fres != FR_OK)
+        return fres;
+
+    fres = SDPlayback_FileSeek(player, offset);
+    if(fres == FR_OK)
+        player->frame = frame;
+
+    return fres;
+}
+
+// Abandons the frame being streamed. While paused, the target frame is presented once.
+// Seeks to a delta frame land on the key frame before it.
+FRESULT SDPlayback_Seek(SDPlayback* player, uint32_t frame) {
+    switch(player->state) {
+    case SDPlayback_READY:
+    case SDPlayback_PLAYING:
+    case SDPlayback_PAUSED:
+    case SDPlayback_FINISHED:
+        break;
+    default:
+        return FR_INVALID_OBJECT;
+    }
+
+    if(frame >= player->info.num_frames)
+        return FR_INVALID_PARAMETER;
 
-    if (fres == FR_OK) {
-        myprintf("Read header from %s.\r\n", vid_path);
+    // close the open RAMWR window; waits for at most one band on SPI1
+    SDPlayback_ReleaseDisplay(player);
+    SDPlayback_AbortFrame(player);
+
+    // delta frames cannot be shown on their own: land on the key frame at or before `frame`
+    FRESULT fres = SDPlayback_FindKeyFrame(player, frame, 0, &frame);
+    if(fres == FR_OK)
+        fres = SDPlayback_SeekFile(player, frame);
+
+    if(fres != FR_OK) {
+        SDPlayback_Fail(player, fres);
+        return fres;
+    }
+
+    // make the target frame due now
+    uint32_t ref_us = (player->state == SDPlayback_PAUSED) ? player->pause_us : PlaybackClock_Micros();
+    player->start_us = ref_us - SDPlayback_FrameTime(&player->info, frame);
+
+    if(player->state == SDPlayback_FINISHED)
+        player->state = SDPlayback_PLAYING;
+
+    player->refresh = (player->state == SDPlayback_PAUSED);
+    return FR_OK;
+}
+
+void SDPlayback_Close(SDPlayback* player) {
+    if(player->state == SDPlayback_CLOSED)
+        return;
+
+    SDPlayback_ReleaseDisplay(player);
+
+    // end the CMD18 session so the card is released
+    if(player->lba != 0)
+        USER_SPI_StreamStop(player->file.obj.fs->drv);
+
+    f_close(&player->file);
+    player->state = SDPlayback_CLOSED;
+}
+
+// Type and payload length of the next frame, leaving the file pointer at its payload. Aligned
+// files describe frames in the index; otherwise the record header is read from the data stream.
+static FRESULT SDPlayback_ReadFrameHeader(SDPlayback* player, uint8_t* type, uint32_t* len) {
+    VidInfo* info = &player->info;
+    FRESULT fres;
+
+    if(info->flags & VID_FLAG_ALIGNED) {
+        const uint8_t* entry;
+        fres = SDPlayback_IndexEntry(player, player->frame, &entry);
+        if(fres != FR_OK)
+            return fres;
+
+        uint32_t offset = Vid_ReadU32(entry) & VID_INDEX_OFFSET_MASK;
+        uint32_t desc = Vid_ReadU32(entry + 4);
+
+        // only after an index read or a dropped frame; sequential frames follow each other
+        if(SDPlayback_FileTell(player) != offset) {
+            fres = SDPlayback_FileSeek(player, offset);
+            if(fres != FR_OK)
+                return fres;
+        }
+
+        *type = VID_DESC_TYPE(desc);
+        *len = VID_DESC_LEN(desc);
+        return FR_OK;
+    }
+
+    uint8_t frame_header[VID_FRAME_HEADER_LEN];
+    fres = SDPlayback_FileRead(player, frame_header, info->frame_header_len);
+    if(fres != FR_OK)
+        return fres;
+
+    // check START flag
+    if(memcmp(frame_header, VID_FRAME_FLAG, VID_FRAME_FLAG_LEN) != 0) {
+        myprintf("START_FLAG not matching for frame %lu. FRAME_FLAG=%.3s\r\n", player->frame, frame_header);
+        return FR_INVALID_OBJECT;
+    }
+
+    if(info->version < 2) {
+        *type = VidFrame_RAW;
+        *len = SDPlayback_FrameBytes(info);
     } else {
-        myprintf("Failed to read header. f_read error (%d)\r\n", fres);
+        *type = frame_header[3];
+        *len = Vid_ReadU32(&frame_header[4]);
     }
 
-    uint16_t vid_width, vid_height, vid_num_frames;
-    vid_width = (header[0] << 8) | (header[1] & 0xFF);
-    vid_height = (header[2] << 8) | (header[3] & 0xFF);
-    vid_num_frames = (header[4] << 8) | (header[5] & 0xFF);
+    return FR_OK;
+}
 
-    // Framewise read information
-    const uint8_t* START_FLAG_VAL = (const uint8_t*) "FRM";
-    uint8_t START_FLAG_LEN = 3;
+// Read the next frame header. The frame's RAMWR window is opened when its first band is submitted,
+// so the header and first band can be read while the previous frame is still on SPI1.
+static void SDPlayback_LoadFrame(SDPlayback* player) {
+    VidInfo* info = &player->info;
+    FRESULT fres;
+    uint8_t type;
+    uint32_t len;
 
-    uint8_t bytes_per_pixel = 2; // RGB565
-    uint32_t frame_read_len = (vid_width * vid_height * bytes_per_pixel) + START_FLAG_LEN;
-    uint32_t frame_read_num_bytes = frame_read_len * sizeof(uint8_t);
+    uint32_t start_us = PlaybackClock_Micros();
+    player->frame_start_us = start_us;
 
-    uint8_t* frame_data_arr = malloc(frame_read_num_bytes);
+    fres = SDPlayback_ReadFrameHeader(player, &type, &len);
+    player->frame_read_us = PlaybackClock_Micros() - start_us;
+    player->frame_read_bytes = 0;
+    if(fres != FR_OK) {
+        myprintf("Failed to read frame %lu\r\n. f_read error (%d)", player->frame, fres);
+        SDPlayback_Fail(player, fres);
+        return;
+    }
 
-    uint32_t elapsed_time = 0; // debug: time measurement
+    // entropy coded payload of a coded frame type
+    player->entropy = (type & VID_FRAME_ENTROPY) != 0;
+    type &= ~VID_FRAME_ENTROPY;
+    if(player->entropy && (type == VidFrame_RAW || !(info->flags & VID_FLAG_ENTROPY))) {
+        myprintf("Unexpected entropy coded frame %lu\r\n", player->frame);
+        SDPlayback_Fail(player, FR_INVALID_OBJECT);
+        return;
+    }
 
-    // Read framewise from video
-    for(int i = 0; i < vid_num_frames; i++) {
-        IFLOG DebugTimer_MeasureTime(DebugTimer_START);
+    if(type == VidFrame_RAW) {
+        if(len != SDPlayback_FrameBytes(info)) {
+            myprintf("Invalid raw frame length %lu for frame %lu\r\n", len, player->frame);
+            SDPlayback_Fail(player, FR_INVALID_OBJECT);
+            return;
+        }
+    } else if(!VidDecoder_Begin(&player->dec, type, info, player->ref)) {
+        myprintf("Unsupported frame type %d for frame %lu\r\n", type, player->frame);
+        SDPlayback_Fail(player, FR_INVALID_OBJECT);
+        return;
+    }
 
-        fres = f_read(&file, frame_data_arr, frame_read_num_bytes, &bytes_read);
-        
-        IFLOG elapsed_time = DebugTimer_MeasureTime(DebugTimer_END);
-        IFLOG myprintf("Frame read time: %dms\r\n", elapsed_time);
+    player->frame_type = type;
+    player->in_pos = player->in_len = 0;
+    player->coded_pos = player->coded_len = 0;
+    player->huff = (VidHuff_State) { 0 };
+    player->frame_entropy_cycles = player->frame_entropy_bytes = 0;
+
+    // aligned files: read the padding too, so the next frame starts on a sector boundary
+    player->frame_padding = 0;
+    if(info->flags & VID_FLAG_ALIGNED)
+        player->frame_padding = (VID_SECTOR_SIZE - len % VID_SECTOR_SIZE) % VID_SECTOR_SIZE;
+
+    player->frame_remaining = len + player->frame_padding;
+    player->frame_draw_started = false;
+
+    // delta and JPEG frames open a window per rectangle (MCU tile) as the decoder reaches it
+    player->window = (VidRect) { 0, 0, info->width, info->height };
+    player->window_pending = (type != VidFrame_DELTA && type != VidFrame_JPEG);
+    player->frame++;
+    player->refresh = false;
+}
 
-        if(fres != FR_OK) {
-            myprintf("Failed to read frame %d\r\n. f_read error (%d)", i, fres);
-            break;
+// Load the next frame once it is due
+static void SDPlayback_StartFrame(SDPlayback* player) {
+    VidInfo* info = &player->info;
+    FRESULT fres;
+
+    if(player->frame >= info->num_frames) {
+        if(ST7735_IsBusy())
+            return;
+
+        SDPlayback_ReleaseDisplay(player);
+        player->state = SDPlayback_FINISHED;
+        return;
+    }
+
+    // Presentation clock: frame i is due at start_us + SDPlayback_FrameTime(i).
+    // Without a frame rate (v1 files), frames are shown as fast as they can be read.
+    if(info->fps_x100 != 0 && !player->refresh) {
+        // early: the clip starts later (a playlist's gapless handoff sets start_us ahead)
+        int32_t elapsed_us = (int32_t) (PlaybackClock_Micros() - player->start_us);
+        if(elapsed_us < 0)
+            return;
+
+        // frame that should be on screen right now
+        uint32_t now_us = elapsed_us;
+        uint32_t due = (uint64_t) now_us * info->fps_x100 / 100000000ULL;
+
+        if(due > player->frame) {
+            // late: the frame's slot has already passed, skip ahead to the due frame
+            if(due >= info->num_frames) {
+                player->dropped_frames += info->num_frames - player->frame;
+                player->frame = info->num_frames;
+                return;
+            }
+
+            // a delta frame needs its predecessor on screen: skip ahead only as far as a key frame,
+            // or not at all and play the next frame late
+            fres = SDPlayback_FindKeyFrame(player, due, player->frame, &due);
+            if(fres == FR_OK) {
+                player->dropped_frames += due - player->frame;
+                fres = SDPlayback_SeekFile(player, due);
+            }
+
+            if(fres != FR_OK) {
+                myprintf("Failed to seek to frame %lu. f_lseek error (%d)\r\n", due, fres);
+                SDPlayback_Fail(player, fres);
+                return;
+            }
+        } else if(now_us < SDPlayback_FrameTime(info, player->frame)) {
+            // early: not due yet
+            return;
         }
+    }
+
+    SDPlayback_LoadFrame(player);
+}
 
-        // check START flag
-        if(memcmp(frame_data_arr, START_FLAG_VAL, START_FLAG_LEN) != 0) {
-            myprintf("START_FLAG not matching for frame %d. FRAME_FLAG=%.3s\r\n", i, frame_data_arr);
-            break;
+// Send a band to the display, opening the frame's RAMWR window first if needed. SPI1 must be free.
+static void SDPlayback_SubmitBand(SDPlayback* player, const uint8_t* band, UINT band_len) {
+    if(player->window_pending) {
+        VidRect* w = &player->window;
+        ST7735_BeginWriteMode(w->x, w->y, w->w, w->h,
+                              (player->info.flags & VID_FLAG_RGB444) ? ST7735_COLOR_12BIT : ST7735_COLOR_16BIT);
+        player->window_pending = false;
+        player->window_pos = 0;
+        player->drawing = true;
+
+        // a key frame replaces the reference frame (once, JPEG frames open a window per tile)
+        if(player->ref != NULL && player->frame_type != VidFrame_DELTA && player->frame_type != VidFrame_MOTION &&
+           !player->frame_draw_started)
+            VidRef_Reset(player->ref, player->info.width, player->info.height);
+
+        if(!player->frame_draw_started) {
+            player->frame_draw_started = true;
+            player->frame_draw_us = PlaybackClock_Micros();
         }
+    }
 
-        IFLOG DebugTimer_MeasureTime(DebugTimer_START);
+    ST7735_WriteAsync(band, band_len);
 
-        ST7735_DrawImage(0, 0, vid_width, vid_height, (frame_data_arr + START_FLAG_LEN));
+    // motion frames are decoded into the reference frame
+    if(player->ref != NULL && player->frame_type != VidFrame_MOTION)
+        VidRef_Write(player->ref, &player->window, player->window_pos, band, band_len);
+    player->window_pos += band_len;
 
-        IFLOG elapsed_time = DebugTimer_MeasureTime(DebugTimer_END);
-        IFLOG myprintf("Frame draw time: %dms\r\n", elapsed_time);
+    if(!SDPlayback_FrameLoaded(player) && player->out_band == NULL) {
+        uint32_t now_us = PlaybackClock_Micros();
+        IFSTATS PlaybackStats_Record(&player->stats, player->frame_read_us, player->frame_read_bytes,
+                                     now_us - player->frame_draw_us, now_us - player->frame_start_us);
+        IFSTATS if(player->entropy)
+            PlaybackStats_RecordEntropy(&player->stats, player->frame_entropy_cycles, player->frame_entropy_bytes);
     }
+}
 
-    HAL_Delay(1000);
+// Read the next band of the current frame into the ring buffer that is not in flight
+static bool SDPlayback_ReadBand(SDPlayback* player, uint8_t** band, UINT* band_len) {
+    FRESULT fres;
 
-    free(frame_data_arr);
-    f_close(&file);
+    *band = player->bands[player->band_idx++ % SDPLAYBACK_BAND_COUNT];
+    *band_len = (player->frame_remaining < SDPLAYBACK_BAND_SIZE) ? player->frame_remaining : SDPLAYBACK_BAND_SIZE;
 
-    // ----------------------------------------------------------------
+    uint32_t start_us = PlaybackClock_Micros();
+    fres = SDPlayback_FileRead(player, *band, *band_len);
+    player->frame_read_us += PlaybackClock_Micros() - start_us;
+    player->frame_read_bytes += *band_len;
 
-    return fres;
+    if(fres != FR_OK) {
+        myprintf("Failed to read frame %lu\r\n. f_read error (%d)", player->frame - 1, fres);
+        SDPlayback_Fail(player, fres);
+        return false;
+    }
+
+    player->frame_remaining -= *band_len;
+
+    // band size is a multiple of the sector size, so the padding is always within the last band
+    if(player->frame_remaining == 0)
+        *band_len -= player->frame_padding;
+
+    return true;
 }
 
-void SDPlayback_Unmount() {
-    f_mount(NULL, "", 0);
-}
\ No newline at end of file
+// Read the next chunk of the current frame's payload into `buf`
+static bool SDPlayback_ReadChunk(SDPlayback* player, uint8_t* buf, UINT* len) {
+    *len = (player->frame_remaining < SDPLAYBACK_IN_SIZE) ? player->frame_remaining : SDPLAYBACK_IN_SIZE;
+
+    uint32_t start_us = PlaybackClock_Micros();
+    FRESULT fres = SDPlayback_FileRead(player, buf, *len);
+    player->frame_read_us += PlaybackClock_Micros() - start_us;
+    player->frame_read_bytes += *len;
+
+    if(fres != FR_OK) {
+        myprintf("Failed to read frame %lu\r\n. f_read error (%d)", player->frame - 1, fres);
+        SDPlayback_Fail(player, fres);
+        return false;
+    }
+
+    player->frame_remaining -= *len;
+    return true;
+}
+
+// Entropy decode the coded chunk into `out`, reading the next chunk once it is used up
+static bool SDPlayback_DecodeEntropy(SDPlayback* player, uint8_t* out, UINT* len) {
+    if(player->coded_pos == player->coded_len && player->frame_remaining > 0) {
+        if(!SDPlayback_ReadChunk(player, player->coded_buf, &player->coded_len))
+            return false;
+        player->coded_pos = 0;
+    }
+
+    VidCodec_In in = { &player->coded_buf[player->coded_pos], &player->coded_buf[player->coded_len] };
+    uint32_t start_cycles = PlaybackClock_Cycles();
+    int32_t produced = VidHuff_Decode(player->huff_lookup, &player->huff, &in, out, SDPLAYBACK_IN_SIZE);
+    player->frame_entropy_cycles += PlaybackClock_Cycles() - start_cycles;
+
+    if(produced < 0) {
+        myprintf("Corrupt entropy coded payload in frame %lu\r\n", player->frame - 1);
+        SDPlayback_Fail(player, FR_INVALID_OBJECT);
+        return false;
+    }
+
+    player->coded_pos = in.ptr - player->coded_buf;
+    player->frame_entropy_bytes += produced;
+    *len = produced;
+    return true;
+}
+
+// More payload for the decoder: unread bytes, or entropy coded bytes not decoded yet
+static bool SDPlayback_InputLeft(const SDPlayback* player) {
+    if(!player->entropy)
+        return player->frame_remaining > 0;
+
+    const VidHuff_State* huff = &player->huff;
+    if(huff->header_len == 4 && huff->left == 0)
+        return false;
+    return player->frame_remaining > 0 || player->coded_pos < player->coded_len || huff->count >= VID_HUFF_MAX_BITS;
+}
+
+// Read (or entropy decode) the next chunk of a coded frame's payload, keeping the unconsumed
+// tail of the previous one
+static bool SDPlayback_FillInput(SDPlayback* player) {
+    UINT keep = player->in_len - player->in_pos;
+    UINT len;
+
+    // decoders only stop short of input with less than one token left
+    if(keep > VID_CODEC_MAX_TOKEN) {
+        SDPlayback_Fail(player, FR_INT_ERR);
+        return false;
+    }
+
+    memmove(player->in_buf, &player->in_buf[player->in_pos], keep);
+
+    if(player->entropy) {
+        if(!SDPlayback_DecodeEntropy(player, &player->in_buf[keep], &len))
+            return false;
+    } else if(!SDPlayback_ReadChunk(player, &player->in_buf[keep], &len)) {
+        return false;
+    }
+
+    player->in_pos = 0;
+    player->in_len = keep + len;
+    return true;
+}
+
+// Decode into the band being filled; at most one chunk read per call
+static bool SDPlayback_DecodeBand(SDPlayback* player) {
+    bool filled = false;
+
+    if(player->out_band == NULL) {
+        player->out_band = player->bands[player->band_idx++ % SDPLAYBACK_BAND_COUNT];
+        player->out_len = 0;
+    }
+
+    for(;;) {
+        VidCodec_In in = { &player->in_buf[player->in_pos], &player->in_buf[player->in_len] };
+        uint32_t start_cycles = PlaybackClock_Cycles();
+        int32_t produced = VidDecoder_Run(&player->dec, &in, &player->out_band[player->out_len],
+                                          SDPLAYBACK_BAND_SIZE - player->out_len);
+        if(produced < 0) {
+            myprintf("Corrupt payload in frame %lu\r\n", player->frame - 1);
+            SDPlayback_Fail(player, FR_INVALID_OBJECT);
+            return false;
+        }
+        // RGB444 pixels are 1.5 bytes
+        IFSTATS PlaybackStats_RecordDecode(&player->stats, player->frame_type, PlaybackClock_Cycles() - start_cycles,
+                                           (player->info.flags & VID_FLAG_RGB444) ? produced * 2 / 3 : produced / 2);
+
+        player->in_pos = in.ptr - player->in_buf;
+        player->out_len += produced;
+
+        // the band's pixels belong to a new rectangle: open its window when the band is submitted
+        if(player->dec.rect_new) {
+            player->dec.rect_new = false;
+            player->window = player->dec.rect;
+            player->window_pending = true;
+        }
+
+        if(player->out_len == SDPLAYBACK_BAND_SIZE || player->dec.out_remaining == 0 || player->dec.band_break)
+            return true;
+
+        // decoder is short of input
+        if(!SDPlayback_InputLeft(player)) {
+            myprintf("Truncated payload in frame %lu\r\n", player->frame - 1);
+            SDPlayback_Fail(player, FR_INVALID_OBJECT);
+            return false;
+        }
+
+        if(filled)
+            return false; // continue on the next poll
+
+        if(!SDPlayback_FillInput(player))
+            return false;
+        filled = true;
+    }
+}
+
+// Produce the next band of the current frame into the ring buffer that is not in flight
+static bool SDPlayback_NextBand(SDPlayback* player, uint8_t** band, UINT* band_len) {
+    if(player->frame_type == VidFrame_RAW)
+        return SDPlayback_ReadBand(player, band, band_len);
+
+    if(!SDPlayback_DecodeBand(player))
+        return false;
+
+    *band = player->out_band;
+    *band_len = player->out_len;
+    player->out_band = NULL;
+
+    // payload left over after the last pixel (padding beyond the read chunks): skip it
+    if(player->dec.out_remaining == 0 && player->frame_remaining > 0) {
+        FRESULT fres = SDPlayback_FileSeek(player, SDPlayback_FileTell(player) + player->frame_remaining);
+        player->frame_remaining = 0;
+        if(fres != FR_OK) {
+            SDPlayback_Fail(player, fres);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// A frame is drawn once due. Frames loaded by SDPlayback_StartFrame() already are; a prerolled
+// frame may start later (a playlist's gapless handoff sets start_us ahead) and is held until then.
+static bool SDPlayback_DrawDue(const SDPlayback* player) {
+    if(player->frame_draw_started || player->info.fps_x100 == 0)
+        return true;
+
+    uint32_t due_us = player->start_us + SDPlayback_FrameTime(&player->info, SDPlayback_CurrentFrame(player));
+    return (int32_t) (PlaybackClock_Micros() - due_us) >= 0;
+}
+
+// Move the current frame along by one band: submit the band produced on the previous poll once
+// SPI1 is free and the frame is due, then read (or decode) the next band
+static void SDPlayback_StreamBand(SDPlayback* player) {
+    uint8_t* band;
+    UINT band_len;
+
+    if(player->band_pending != NULL) {
+        if(ST7735_IsBusy() || !SDPlayback_DrawDue(player))
+            return;
+
+        SDPlayback_SubmitBand(player, player->band_pending, player->band_pending_len);
+        player->band_pending = NULL;
+
+        if(!SDPlayback_FrameLoaded(player))
+            return;
+    }
+
+    if(!SDPlayback_NextBand(player, &band, &band_len))
+        return;
+
+    // delta frame without changes
+    if(band_len == 0)
+        return;
+
+    if(ST7735_IsBusy() || !SDPlayback_DrawDue(player)) {
+        player->band_pending = band;
+        player->band_pending_len = band_len;
+        return;
+    }
+
+    SDPlayback_SubmitBand(player, band, band_len);
+}
+
+FRESULT SDPlayback_Preroll(SDPlayback* player) {
+    if(player->state != SDPlayback_READY)
+        return FR_INVALID_OBJECT;
+
+    if(SDPlayback_FrameInProgress(player))
+        return FR_OK; // already prerolled
+
+    if(player->frame >= player->info.num_frames)
+        return FR_OK;
+
+    uint8_t* band;
+    UINT band_len;
+
+    SDPlayback_LoadFrame(player);
+    if(player->state == SDPlayback_ERROR)
+        return player->error;
+
+    // coded frames: read the first chunk, decoding is left to the first poll
+    if(player->frame_type != VidFrame_RAW) {
+        SDPlayback_FillInput(player);
+        return (player->state == SDPlayback_ERROR) ? player->error : FR_OK;
+    }
+
+    if(!SDPlayback_ReadBand(player, &band, &band_len))
+        return player->error;
+
+    // submitted by the first poll after SDPlayback_Play()
+    player->band_pending = band;
+    player->band_pending_len = band_len;
+    return FR_OK;
+}
+
+SDPlayback_State SDPlayback_Poll(SDPlayback* player) {
+    if(player->state != SDPlayback_PLAYING && player->state != SDPlayback_PAUSED)
+        return player->state;
+
+    if(SDPlayback_FrameInProgress(player))
+        SDPlayback_StreamBand(player);
+    else if(player->state == SDPlayback_PLAYING || player->refresh)
+        SDPlayback_StartFrame(player);
+
+    return player->state;
+}
+
+FRESULT SDPlayback_Begin() {
+    static SDPlayback player; // holds the band ring, keep it off the stack
+    FRESULT fres;
+
+    fres = SDPlayback_Mount();
+    if(fres != FR_OK)
+        return fres;
+
+    fres = SDPlayback_Open(&player, VID_BIN_PATH);
+    if(fres != FR_OK)
+        return fres;
+
+    SDPlayback_Play(&player);
+    while(SDPlayback_Poll(&player) == SDPlayback_PLAYING);
+
+    if(player.state == SDPlayback_ERROR)
+        fres = player.error;
+    else if(player.info.fps_x100 != 0)
+        myprintf("Dropped %lu of %lu frames\r\n", player.dropped_frames, player.info.num_frames);
+
+    IFSTATS PlaybackStats_Print(&player.stats);
+
+    HAL_Delay(1000);
+
+    SDPlayback_Close(&player);
+    return fres;
+}
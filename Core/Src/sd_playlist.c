@@ -0,0 +1,193 @@
+#include <stm32f4xx_hal.h>
+#include <stdio.h>
+
+#include "sd_playlist.h"
+#include "utils.h"
+#include "playback_clock.h"
+
+static SDPlayback* SDPlaylist_Next(SDPlaylist* list) {
+    return &list->players[list->current ^ 1];
+}
+
+// Find the next file name, rewinding the directory when looping
+static FRESULT SDPlaylist_FindNext(SDPlaylist* list) {
+    FRESULT fres = f_findnext(&list->dir_obj, &list->fno);
+
+    if(fres == FR_OK && list->fno.fname[0] == 0 && list->loop) {
+        // a full pass without a single playable file: stop instead of spinning on the directory
+        if(!list->pass_ok)
+            return FR_NO_FILE;
+
+        f_closedir(&list->dir_obj);
+        list->pass_ok = false;
+        fres = f_findfirst(&list->dir_obj, &list->fno, list->dir, SDPLAYLIST_PATTERN);
+    }
+
+    if(fres != FR_OK)
+        return fres;
+
+    if(list->fno.fname[0] == 0)
+        return FR_NO_FILE;
+
+    snprintf(list->next_path, sizeof(list->next_path), "%s/%s", list->dir, list->fno.fname);
+    return FR_OK;
+}
+
+// One step of preparing the next clip. Each step does at most one read from the card, so it can
+// run alongside playback of the current clip.
+static void SDPlaylist_PrerollStep(SDPlaylist* list) {
+    SDPlayback* next = SDPlaylist_Next(list);
+    FRESULT fres;
+
+    switch(list->preroll) {
+    case SDPlaylist_PREROLL_FIND:
+        fres = SDPlaylist_FindNext(list);
+        if(fres != FR_OK) {
+            list->has_next = false;
+            list->preroll = SDPlaylist_PREROLL_DONE;
+        } else {
+            list->preroll = SDPlaylist_PREROLL_OPEN;
+        }
+        break;
+
+    case SDPlaylist_PREROLL_OPEN:
+        fres = SDPlayback_Open(next, list->next_path);
+        // skip files that cannot be played
+        list->preroll = (fres == FR_OK) ? SDPlaylist_PREROLL_FILL : SDPlaylist_PREROLL_FIND;
+        break;
+
+    case SDPlaylist_PREROLL_FILL:
+        fres = SDPlayback_Preroll(next);
+        if(fres != FR_OK) {
+            SDPlayback_Close(next);
+            list->preroll = SDPlaylist_PREROLL_FIND;
+            break;
+        }
+
+        list->pass_ok = true;
+        list->has_next = true;
+        list->preroll = SDPlaylist_PREROLL_DONE;
+        break;
+
+    case SDPlaylist_PREROLL_DONE:
+        break;
+    }
+}
+
+static void SDPlaylist_PrerollAll(SDPlaylist* list) {
+    while(list->preroll != SDPlaylist_PREROLL_DONE)
+        SDPlaylist_PrerollStep(list);
+}
+
+FRESULT SDPlaylist_Open(SDPlaylist* list, const char* dir, bool loop) {
+    FRESULT fres;
+
+    list->state = SDPlayback_CLOSED;
+    list->dir = dir;
+    list->loop = loop;
+    list->current = 1; // the first clip is prerolled into players[0]
+    list->players[0].state = SDPlayback_CLOSED;
+    list->players[1].state = SDPlayback_CLOSED;
+    list->has_next = false;
+    list->pass_ok = false;
+    list->dropped_frames = 0;
+    PlaybackStats_Reset(&list->stats);
+
+    fres = f_findfirst(&list->dir_obj, &list->fno, dir, SDPLAYLIST_PATTERN);
+    if(fres != FR_OK) {
+        myprintf("Failed to open %s. f_findfirst error (%d)\r\n", dir, fres);
+        return fres;
+    }
+
+    // f_findfirst already holds the first match: start with OPEN instead of FIND
+    if(list->fno.fname[0] == 0) {
+        myprintf("No %s files in %s\r\n", SDPLAYLIST_PATTERN, dir);
+        f_closedir(&list->dir_obj);
+        return FR_NO_FILE;
+    }
+
+    snprintf(list->next_path, sizeof(list->next_path), "%s/%s", dir, list->fno.fname);
+    list->preroll = SDPlaylist_PREROLL_OPEN;
+    SDPlaylist_PrerollAll(list);
+
+    if(!list->has_next) {
+        myprintf("No playable files in %s\r\n", dir);
+        f_closedir(&list->dir_obj);
+        return FR_NO_FILE;
+    }
+
+    list->current ^= 1;
+    list->preroll = SDPlaylist_PREROLL_FIND;
+    list->has_next = false;
+    list->state = SDPlayback_PLAYING;
+    list->error = FR_OK;
+
+    SDPlayback_Play(SDPlaylist_Current(list));
+    return FR_OK;
+}
+
+// Current clip has ended (or failed): hand over to the prerolled player
+static void SDPlaylist_Switch(SDPlaylist* list) {
+    SDPlayback* current = SDPlaylist_Current(list);
+    uint32_t due_us = PlaybackClock_Micros();
+
+    if(current->state == SDPlayback_FINISHED) {
+        // start the next clip where this one ends, unless that is already in the past
+        uint32_t end_us = SDPlayback_EndTime(current);
+        if((int32_t) (end_us - due_us) > 0)
+            due_us = end_us;
+    } else {
+        myprintf("Error occurred during video playback (%d), skipping clip\r\n", current->error);
+    }
+
+    PlaybackStats_Merge(&list->stats, &current->stats);
+    list->dropped_frames += current->dropped_frames;
+
+    // a finished player has released the display; the next one may open its window now
+    SDPlayback_Close(current);
+
+    SDPlaylist_PrerollAll(list);
+
+    if(!list->has_next) {
+        // when looping, running out of files means none of them could be played
+        list->state = list->loop ? SDPlayback_ERROR : SDPlayback_FINISHED;
+        list->error = list->loop ? FR_NO_FILE : FR_OK;
+        return;
+    }
+
+    list->current ^= 1;
+    list->preroll = SDPlaylist_PREROLL_FIND;
+    list->has_next = false;
+
+    SDPlayback_PlayAt(SDPlaylist_Current(list), due_us);
+}
+
+SDPlayback_State SDPlaylist_Poll(SDPlaylist* list) {
+    if(list->state != SDPlayback_PLAYING)
+        return list->state;
+
+    SDPlayback* current = SDPlaylist_Current(list);
+    SDPlayback_State state = SDPlayback_Poll(current);
+
+    if(state == SDPlayback_FINISHED || state == SDPlayback_ERROR) {
+        SDPlaylist_Switch(list);
+        return list->state;
+    }
+
+    // near the end of the clip: prepare the next one, one step per poll
+    if(state == SDPlayback_PLAYING && list->preroll != SDPlaylist_PREROLL_DONE &&
+       current->frame + SDPLAYLIST_PREROLL_FRAMES >= current->info.num_frames)
+        SDPlaylist_PrerollStep(list);
+
+    return list->state;
+}
+
+void SDPlaylist_Close(SDPlaylist* list) {
+    SDPlayback_Close(&list->players[0]);
+    SDPlayback_Close(&list->players[1]);
+
+    if(list->state != SDPlayback_CLOSED)
+        f_closedir(&list->dir_obj);
+
+    list->state = SDPlayback_CLOSED;
+}
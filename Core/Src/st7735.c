@@ -5,6 +5,12 @@
 #define USE_DMA
 volatile int ST7735_dma_tx_done = 0;
 
+// set while an asynchronous write owns the display (CS low, inside RAMWR)
+static volatile int ST7735_async_pending = 0;
+
+// COLMOD last sent to the display
+static ST7735_ColorMode ST7735_color_mode = ST7735_COLOR_16BIT;
+
 // delay marker has only MSbit set. number_of_args will not use the MSB
 // if only DELAY_MARKER, then number_of_args will be zero
 #define DELAY_MARKER 0x80
@@ -141,6 +147,17 @@ static void ST7735_ExecuteCommandList(const uint8_t* cmd_arr) {
     }
 }
 
+// display must be selected
+static void ST7735_SetColorMode(ST7735_ColorMode mode) {
+    if(mode == ST7735_color_mode)
+        return;
+
+    uint8_t colmod = mode;
+    ST7735_WriteCommand(ST7735_COLMOD);
+    ST7735_WriteData(&colmod, sizeof(colmod));
+    ST7735_color_mode = mode;
+}
+
 static void ST7735_SetAddressWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
     // column address set
     ST7735_WriteCommand(ST7735_CASET);
@@ -172,6 +189,7 @@ void ST7735_Init(void) {
     ST7735_ExecuteCommandList(init_cmds1);
     // ST7735_ExecuteCommandList(init_cmds2);
     ST7735_ExecuteCommandList(init_cmds3);
+    ST7735_color_mode = ST7735_COLOR_16BIT; // set by init_cmds1
 
     ST7735_Unselect();
 }
@@ -181,6 +199,7 @@ void ST7735_DrawPixel(uint16_t x, uint16_t y, uint16_t color) {
         return;
 
     ST7735_Select(); // select is necessary before set address window, since it uses SPI for ST7735_WriteCommand
+    ST7735_SetColorMode(ST7735_COLOR_16BIT);
     ST7735_SetAddressWindow(x, y, x, y);
 
     uint8_t data[] = { color >> 8, color & 0xFF};
@@ -210,6 +229,7 @@ static void ST7735_WriteChar(uint16_t x, uint16_t y, char ch, FontDef font, uint
 
 void ST7735_WriteString(uint16_t x, uint16_t y, const char* str, FontDef font, uint16_t color, uint16_t bgcolor) {
     ST7735_Select();
+    ST7735_SetColorMode(ST7735_COLOR_16BIT);
 
     while(*str) {
         if(x + font.width >= ST7735_WIDTH) {
@@ -240,6 +260,7 @@ void ST7735_FillRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16
     if((y + h - 1) >= ST7735_HEIGHT) h = ST7735_HEIGHT - y;
 
     ST7735_Select();
+    ST7735_SetColorMode(ST7735_COLOR_16BIT);
     ST7735_SetAddressWindow(x, y, x+w-1, y+h-1);
 
     uint8_t data[] = {color >> 8, color & 0xFF};
@@ -266,6 +287,7 @@ void ST7735_FillRectangleFast(uint16_t x, uint16_t y, uint16_t w, uint16_t h, ui
     if((y + h - 1) >= ST7735_HEIGHT) h = ST7735_HEIGHT - y;
 
     ST7735_Select();
+    ST7735_SetColorMode(ST7735_COLOR_16BIT);
     ST7735_SetAddressWindow(x, y, x+w-1, y+h-1);
 
     // 128 * 160 * 2 ~ 40kilobytes for entire screen buffer
@@ -308,11 +330,68 @@ void ST7735_DrawImage(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint
     if((y + h - 1) >= ST7735_HEIGHT) h = ST7735_HEIGHT - y;
 
     ST7735_Select();
+    ST7735_SetColorMode(ST7735_COLOR_16BIT);
     ST7735_SetAddressWindow(x, y, x+w-1, y+h-1);
     ST7735_WriteData((uint8_t*) data, sizeof(uint16_t) * w * h);
     ST7735_Unselect();
 }
 
+void ST7735_BeginWrite(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+    ST7735_BeginWriteMode(x, y, w, h, ST7735_COLOR_16BIT);
+}
+
+void ST7735_BeginWriteMode(uint16_t x, uint16_t y, uint16_t w, uint16_t h, ST7735_ColorMode mode) {
+    if(x >= ST7735_WIDTH || y >= ST7735_HEIGHT) return;
+    if((x + w - 1) >= ST7735_WIDTH) w = ST7735_WIDTH - x;
+    if((y + h - 1) >= ST7735_HEIGHT) h = ST7735_HEIGHT - y;
+
+    // finish the previous transfer before reusing the bus
+    ST7735_WaitDrawImage();
+
+    ST7735_Select();
+    ST7735_SetColorMode(mode);
+    ST7735_SetAddressWindow(x, y, x+w-1, y+h-1);
+    HAL_GPIO_WritePin(ST7735_DC_GPIO_Port, ST7735_DC_Pin, GPIO_PIN_SET);
+
+    // display stays selected (inside RAMWR) until ST7735_WaitDrawImage()
+    ST7735_dma_tx_done = 1;
+    ST7735_async_pending = 1;
+}
+
+void ST7735_WriteAsync(const uint8_t* data, size_t len) {
+    // wait only for the previous chunk; the RAMWR window stays open
+    while(!ST7735_dma_tx_done);
+
+#ifdef USE_DMA
+    ST7735_dma_tx_done = 0;
+    HAL_SPI_Transmit_DMA(&ST7735_SPI_PORT, (uint8_t*) data, len);
+#else
+    HAL_SPI_Transmit(&ST7735_SPI_PORT, (uint8_t*) data, len, HAL_MAX_DELAY);
+#endif
+}
+
+void ST7735_DrawImageAsync(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t* data) {
+    if(x >= ST7735_WIDTH || y >= ST7735_HEIGHT) return;
+    if((x + w - 1) >= ST7735_WIDTH) w = ST7735_WIDTH - x;
+    if((y + h - 1) >= ST7735_HEIGHT) h = ST7735_HEIGHT - y;
+
+    ST7735_BeginWrite(x, y, w, h);
+    ST7735_WriteAsync(data, sizeof(uint16_t) * w * h);
+}
+
+void ST7735_WaitDrawImage(void) {
+    if(!ST7735_async_pending)
+        return;
+
+    while(!ST7735_dma_tx_done);
+    ST7735_async_pending = 0;
+    ST7735_Unselect();
+}
+
+bool ST7735_IsBusy(void) {
+    return ST7735_async_pending && !ST7735_dma_tx_done;
+}
+
 void ST7735_InvertColors(bool invert) {
     ST7735_WriteCommand(invert ? ST7735_INVON : ST7735_INVOFF);
 }
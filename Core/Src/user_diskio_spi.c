@@ -318,6 +318,32 @@ BYTE send_cmd (		/* Return value: R1 resp (bit7==1:Failed to send) */
 }
 
 
+/*-----------------------------------------------------------------------*/
+/* Streaming read session state                                          */
+/*-----------------------------------------------------------------------*/
+
+//A stream session is one open-ended READ_MULTIPLE_BLOCK: the card stays selected
+//between USER_SPI_StreamRead calls and CMD12 is sent only when the session stops.
+//Every other disk access stops the session first.
+
+static
+BYTE StreamActive;		/* 1: CMD18 in progress, card selected */
+
+static
+DWORD StreamSector;		/* Next sector the card will send (LBA) */
+
+static
+void stream_stop (void)
+{
+	if (!StreamActive) return;
+
+	StreamActive = 0;
+	send_cmd(CMD12, 0);				/* STOP_TRANSMISSION */
+	despiselect();
+}
+
+
+
 /*--------------------------------------------------------------------------
 
    Public FatFs Functions (wrapped in user_diskio.c)
@@ -344,6 +370,8 @@ inline DSTATUS USER_SPI_initialize (
 	if (drv != 0) return STA_NOINIT;		/* Supports only drive 0 */
 	//assume SPI already init init_spi();	/* Initialize SPI */
 
+	stream_stop();
+
 	if (Stat & STA_NODISK) return Stat;	/* Is card existing in the soket? */
 
 	FCLK_SLOW();
@@ -418,6 +446,8 @@ inline DRESULT USER_SPI_read (
 	if (drv || !count) return RES_PARERR;		/* Check parameter */
 	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check if drive is ready */
 
+	stream_stop();
+
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* LBA ot BA conversion (byte addressing cards) */
 
 	if (count == 1) {	/* Single sector read */
@@ -444,6 +474,59 @@ inline DRESULT USER_SPI_read (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Streaming read session                                                */
+/*-----------------------------------------------------------------------*/
+
+//Read `count` sectors at `sector` inside a stream session. A read that continues where
+//the previous one ended only receives the data blocks: no command, no busy wait and no
+//CMD12. Any other sector stops the session and starts a new CMD18 there.
+DRESULT USER_SPI_StreamRead (
+	BYTE drv,		/* Physical drive number (0) */
+	BYTE *buff,		/* Pointer to the data buffer to store read data */
+	DWORD sector,	/* Start sector number (LBA) */
+	UINT count		/* Number of sectors to read */
+)
+{
+	if (drv || !count) return RES_PARERR;		/* Check parameter */
+	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check if drive is ready */
+
+	if (StreamActive && sector != StreamSector) stream_stop();	/* Seek */
+
+	if (!StreamActive) {
+		DWORD addr = (CardType & CT_BLOCK) ? sector : sector * 512;	/* LBA ot BA conversion */
+		if (send_cmd(CMD18, addr) != 0) {	/* READ_MULTIPLE_BLOCK */
+			despiselect();
+			return RES_ERROR;
+		}
+		StreamActive = 1;
+		StreamSector = sector;
+	}
+
+	do {
+		if (!rcvr_datablock(buff, 512)) {
+			stream_stop();
+			return RES_ERROR;
+		}
+		buff += 512;
+		StreamSector++;
+	} while (--count);
+
+	return RES_OK;
+}
+
+//End the stream session (CMD12) and release the card. Call before leaving the card idle.
+void USER_SPI_StreamStop (
+	BYTE drv		/* Physical drive number (0) */
+)
+{
+	if (drv) return;
+
+	stream_stop();
+}
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Write sector(s)                                                       */
 /*-----------------------------------------------------------------------*/
@@ -460,6 +543,8 @@ inline DRESULT USER_SPI_write (
 	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check drive status */
 	if (Stat & STA_PROTECT) return RES_WRPRT;	/* Check write protect */
 
+	stream_stop();
+
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* LBA ==> BA conversion (byte addressing cards) */
 
 	if (count == 1) {	/* Single sector write */
@@ -504,6 +589,8 @@ inline DRESULT USER_SPI_ioctl (
 	if (drv) return RES_PARERR;					/* Check parameter */
 	if (Stat & STA_NOINIT) return RES_NOTRDY;	/* Check if drive is ready */
 
+	stream_stop();
+
 	res = RES_ERROR;
 
 	switch (cmd) {
@@ -0,0 +1,75 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+// Line `line` (0..3) of a block: its 4 pixels in display byte order
+static inline void VidBtc_BlockLine(const uint8_t* block, uint32_t line, uint16_t px[4]) {
+    uint16_t c0, c1;
+    memcpy(&c0, &block[0], 2);
+    memcpy(&c1, &block[2], 2);
+
+    uint32_t bits = Vid_ReadU16(&block[4]) >> (12 - 4 * line);
+    uint16_t diff = c0 ^ c1;
+
+    px[0] = c0 ^ (diff & -((bits >> 3) & 1));
+    px[1] = c0 ^ (diff & -((bits >> 2) & 1));
+    px[2] = c0 ^ (diff & -((bits >> 1) & 1));
+    px[3] = c0 ^ (diff & -(bits & 1));
+}
+
+int32_t VidBtc_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    VidBtc_State* st = &dec->s.btc;
+    uint32_t row_len = (uint32_t) dec->width / VID_BTC_BLOCK * VID_BTC_BLOCK_LEN;
+    uint8_t* p = out;
+    uint8_t* end = out + out_cap;
+
+    while(p < end) {
+        // the coded block row is kept whole: each of its 4 lines reads every block
+        if(st->row_loaded < row_len) {
+            uint32_t n = row_len - st->row_loaded;
+            uint32_t avail = in->end - in->ptr;
+            if(n > avail)
+                n = avail;
+
+            memcpy(&st->row[st->row_loaded], in->ptr, n);
+            in->ptr += n;
+            st->row_loaded += n;
+            if(st->row_loaded < row_len)
+                break; // short of input
+        }
+
+        uint32_t line = st->y % VID_BTC_BLOCK;
+        const uint8_t* block = &st->row[st->x / VID_BTC_BLOCK * VID_BTC_BLOCK_LEN];
+        uint16_t px[4];
+
+        // whole block lines while they fit, then single pixels
+        if(st->x % VID_BTC_BLOCK == 0) {
+            uint32_t n = (dec->width - st->x) / VID_BTC_BLOCK;
+            uint32_t room = (end - p) / (VID_BTC_BLOCK * 2);
+            if(n > room)
+                n = room;
+
+            for(uint32_t k = 0; k < n; k++, block += VID_BTC_BLOCK_LEN, p += VID_BTC_BLOCK * 2) {
+                VidBtc_BlockLine(block, line, px);
+                memcpy(p, px, sizeof(px));
+            }
+            st->x += n * VID_BTC_BLOCK;
+        }
+
+        if(st->x < dec->width && p < end) {
+            VidBtc_BlockLine(block, line, px);
+            memcpy(p, &px[st->x % VID_BTC_BLOCK], 2);
+            p += 2;
+            st->x++;
+        }
+
+        if(st->x == dec->width) {
+            st->x = 0;
+            st->y++;
+            if(st->y % VID_BTC_BLOCK == 0)
+                st->row_loaded = 0;
+        }
+    }
+
+    return p - out;
+}
@@ -0,0 +1,133 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+bool VidDecoder_Begin(VidDecoder* dec, uint8_t type, const VidInfo* info, VidRef* ref) {
+    memset(dec, 0, sizeof(*dec));
+    dec->type = type;
+    dec->width = info->width;
+    dec->height = info->height;
+    dec->rect = (VidRect) { 0, 0, info->width, info->height };
+    dec->rgb444 = (info->flags & VID_FLAG_RGB444) != 0;
+    dec->out_remaining = Vid_PixelBytes(info, (uint32_t) info->width * info->height);
+
+    // packed RGB444 bytes are only copied: RLE blocks of 2 bytes, LZ and delta rectangles
+    if(dec->rgb444 && !(type == VidFrame_DELTA || type == VidFrame_LZ ||
+                        (type == VidFrame_RLE && dec->out_remaining % 2 == 0))) {
+        dec->out_remaining = 0;
+        return false;
+    }
+
+    switch(type) {
+    case VidFrame_RLE:
+    case VidFrame_LZ:
+    case VidFrame_I8:
+    case VidFrame_I4:
+    case VidFrame_MONO:
+        return true;
+    case VidFrame_DELTA:
+        dec->out_remaining = UINT32_MAX; // set from the payload header
+        return true;
+    case VidFrame_YUV420:
+        if(info->width % 2 == 0 && info->width <= VID_YUV_MAX_WIDTH)
+            return true;
+        dec->out_remaining = 0;
+        return false;
+    case VidFrame_BTC:
+        if(info->width % VID_BTC_BLOCK == 0 && info->height % VID_BTC_BLOCK == 0 && info->width <= VID_BTC_MAX_WIDTH)
+            return true;
+        dec->out_remaining = 0;
+        return false;
+    case VidFrame_VQ:
+        if(info->width % VID_VQ_BLOCK == 0 && info->height % VID_VQ_BLOCK == 0 && info->width <= VID_VQ_MAX_WIDTH)
+            return true;
+        dec->out_remaining = 0;
+        return false;
+    case VidFrame_JPEG:
+        dec->s.jpeg.symbol = -1;
+        return true;
+    case VidFrame_MOTION:
+        if(ref != NULL && ref->width == info->width && ref->height == info->height) {
+            dec->ref = ref;
+            return true;
+        }
+        dec->out_remaining = 0;
+        return false;
+    default:
+        dec->out_remaining = 0;
+        return false;
+    }
+}
+
+int32_t VidDecoder_Run(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    int32_t produced;
+
+    if(out_cap > dec->out_remaining)
+        out_cap = dec->out_remaining;
+
+    dec->band_break = false;
+
+    switch(dec->type) {
+    case VidFrame_RLE:
+        produced = VidRle_Decode(&dec->s.rle, in, out, out_cap);
+        break;
+    case VidFrame_DELTA:
+        produced = VidDelta_Decode(dec, in, out, out_cap);
+        break;
+    case VidFrame_MOTION:
+        produced = VidMotion_Decode(dec, in, out, out_cap);
+        break;
+    case VidFrame_I8:
+        produced = VidI8_Decode(&dec->s.palette, in, out, out_cap);
+        break;
+    case VidFrame_I4:
+        produced = VidI4_Decode(&dec->s.palette, in, out, out_cap);
+        break;
+    case VidFrame_MONO:
+        produced = VidMono_Decode(&dec->s.mono, in, out, out_cap);
+        break;
+    case VidFrame_YUV420:
+        produced = VidYuv_Decode(dec, in, out, out_cap);
+        break;
+    case VidFrame_BTC:
+        produced = VidBtc_Decode(dec, in, out, out_cap);
+        break;
+    case VidFrame_VQ:
+        produced = VidVq_Decode(dec, in, out, out_cap);
+        break;
+    case VidFrame_LZ:
+        produced = VidLz_Decode(dec, in, out, out_cap);
+        break;
+    case VidFrame_JPEG:
+        produced = VidJpeg_Decode(dec, in, out, out_cap);
+        break;
+    default:
+        return -1;
+    }
+
+    if(produced > 0)
+        dec->out_remaining -= produced;
+
+    return produced;
+}
+
+void VidCodec_Fill(uint8_t* out, const uint8_t value[2], uint32_t len) {
+    uint16_t v16;
+    memcpy(&v16, value, sizeof(v16));
+
+    uint16_t* p = (uint16_t*) out;
+    uint16_t* end = (uint16_t*) (out + len);
+
+    // word stores for the aligned middle of long runs
+    if(((uintptr_t) p & 2) && p < end)
+        *p++ = v16;
+
+    uint32_t v32 = ((uint32_t) v16 << 16) | v16;
+    while(p + 2 <= end) {
+        *(uint32_t*) p = v32;
+        p += 2;
+    }
+
+    if(p < end)
+        *p = v16;
+}
@@ -0,0 +1,74 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+int32_t VidDelta_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    VidDelta_State* st = &dec->s.delta;
+    uint8_t* p = out;
+    uint8_t* end = out + out_cap;
+
+    if(!st->header_done) {
+        if(in->end - in->ptr < VID_DELTA_HEADER_LEN)
+            return 0;
+
+        st->rects_left = Vid_ReadU16(&in->ptr[0]);
+        dec->out_remaining = Vid_ReadU32(&in->ptr[2]);
+        in->ptr += VID_DELTA_HEADER_LEN;
+        st->header_done = true;
+
+        // out_cap was clamped to the unknown length
+        if((uint32_t) (end - p) > dec->out_remaining)
+            end = p + dec->out_remaining;
+    }
+
+    while(p < end) {
+        if(st->rect_left == 0) {
+            if(st->rects_left == 0)
+                return -1; // pixel_bytes does not match the rectangles
+
+            // a band never spans two rectangles: they are drawn in separate windows
+            if(p > out) {
+                dec->band_break = true;
+                break;
+            }
+
+            if(in->end - in->ptr < VID_DELTA_RECT_LEN)
+                break;
+
+            VidRect r = {
+                Vid_ReadU16(&in->ptr[0]), Vid_ReadU16(&in->ptr[2]),
+                Vid_ReadU16(&in->ptr[4]), Vid_ReadU16(&in->ptr[6]),
+            };
+            in->ptr += VID_DELTA_RECT_LEN;
+
+            if(r.w == 0 || r.h == 0 || (uint32_t) r.x + r.w > dec->width || (uint32_t) r.y + r.h > dec->height)
+                return -1;
+
+            uint32_t pixels = (uint32_t) r.w * r.h;
+            if(dec->rgb444 && pixels % 2 != 0)
+                return -1;
+
+            dec->rect = r;
+            dec->rect_new = true;
+            st->rects_left--;
+            st->rect_left = dec->rgb444 ? pixels / 2 * 3 : pixels * 2;
+            continue;
+        }
+
+        uint32_t n = end - p;
+        uint32_t avail = in->end - in->ptr;
+        if(n > st->rect_left)
+            n = st->rect_left;
+        if(n > avail)
+            n = avail;
+        if(n == 0)
+            break;
+
+        memcpy(p, in->ptr, n);
+        in->ptr += n;
+        p += n;
+        st->rect_left -= n;
+    }
+
+    return p - out;
+}
@@ -0,0 +1,84 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+bool VidHuff_Build(uint16_t* lookup, const uint8_t* table) {
+    uint8_t lens[256];
+    uint32_t counts[VID_HUFF_MAX_BITS + 1] = { 0 };
+
+    for(uint32_t i = 0; i < 256; i++) {
+        lens[i] = (i % 2 == 0) ? table[i / 2] >> 4 : table[i / 2] & 0x0F;
+        if(lens[i] > VID_HUFF_MAX_BITS)
+            return false;
+        counts[lens[i]]++;
+    }
+
+    // first canonical code of each length
+    uint32_t next[VID_HUFF_MAX_BITS + 1];
+    uint32_t code = 0;
+    counts[0] = 0;
+    for(uint32_t len = 1; len <= VID_HUFF_MAX_BITS; len++) {
+        code = (code + counts[len - 1]) << 1;
+        next[len] = code;
+    }
+
+    // every code fills the lookup entries that start with it; unfilled entries stay 0 (corrupt)
+    memset(lookup, 0, sizeof(uint16_t) << VID_HUFF_MAX_BITS);
+    for(uint32_t sym = 0; sym < 256; sym++) {
+        uint32_t len = lens[sym];
+        if(len == 0)
+            continue;
+
+        uint32_t first = next[len]++ << (VID_HUFF_MAX_BITS - len);
+        uint32_t n = 1u << (VID_HUFF_MAX_BITS - len);
+        if(first + n > (1u << VID_HUFF_MAX_BITS))
+            return false; // over-subscribed
+
+        for(uint32_t i = 0; i < n; i++)
+            lookup[first + i] = (len << 8) | sym;
+    }
+
+    return true;
+}
+
+int32_t VidHuff_Decode(const uint16_t* lookup, VidHuff_State* st, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    uint8_t* p = out;
+
+    while(st->header_len < 4) {
+        if(in->ptr == in->end)
+            return 0;
+        st->left = (st->left << 8) | *in->ptr++;
+        st->header_len++;
+    }
+
+    if(out_cap > st->left)
+        out_cap = st->left;
+    uint8_t* end = out + out_cap;
+
+    // bits are kept left aligned in a 32-bit buffer; the payload ends with padding, so a symbol
+    // is decoded only with at least VID_HUFF_MAX_BITS bits buffered
+    uint32_t bits = st->bits;
+    uint32_t count = st->count;
+    while(p < end) {
+        while(count <= 24 && in->ptr < in->end) {
+            bits |= (uint32_t) *in->ptr++ << (24 - count);
+            count += 8;
+        }
+        if(count < VID_HUFF_MAX_BITS)
+            break; // short of input
+
+        uint32_t entry = lookup[bits >> (32 - VID_HUFF_MAX_BITS)];
+        uint32_t len = entry >> 8;
+        if(len == 0)
+            return -1;
+
+        *p++ = entry;
+        bits <<= len;
+        count -= len;
+    }
+
+    st->bits = bits;
+    st->count = count;
+    st->left -= p - out;
+    return p - out;
+}
@@ -0,0 +1,611 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+// Markers
+#define VID_JPEG_SOF0   0xC0    // baseline
+#define VID_JPEG_SOF1   0xC1    // extended sequential, Huffman (8-bit samples only)
+#define VID_JPEG_DHT    0xC4
+#define VID_JPEG_RST0   0xD0
+#define VID_JPEG_RST7   0xD7
+#define VID_JPEG_SOI    0xD8
+#define VID_JPEG_EOI    0xD9
+#define VID_JPEG_SOS    0xDA
+#define VID_JPEG_DQT    0xDB
+#define VID_JPEG_DRI    0xDD
+
+// Natural order position of each zigzag coefficient
+static const uint8_t VidJpeg_Zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Derived tables of a Huffman table whose counts and values are loaded; false if the counts
+// describe more codes than fit
+static bool VidJpeg_BuildHuff(VidJpeg_Huff* h, const uint8_t* counts) {
+    int32_t code = 0;
+    int32_t index = 0;
+
+    memset(h->lookup, 0, sizeof(h->lookup));
+    for(int32_t len = 1; len <= 16; len++) {
+        int32_t n = counts[len - 1];
+        if(code + n > (1 << len))
+            return false;
+        h->valoff[len] = index - code;
+        h->maxcode[len] = n ? code + n - 1 : -1;
+
+        // short codes fill every lookup entry that starts with them
+        for(int32_t i = 0; i < n && len <= 8; i++) {
+            uint32_t first = (uint32_t) (code + i) << (8 - len);
+            for(uint32_t j = 0; j < (1u << (8 - len)); j++)
+                h->lookup[first + j] = (len << 8) | h->values[index + i];
+        }
+
+        code = (code + n) << 1;
+        index += n;
+    }
+
+    return true;
+}
+
+// SOF: frame of the video's size, 1 or 3 components
+static bool VidJpeg_Frame(VidDecoder* dec, VidJpeg_State* st) {
+    const uint8_t* s = st->seg;
+    uint32_t comps = s[5];
+
+    if(s[0] != 8 || Vid_ReadU16(&s[1]) != dec->height || Vid_ReadU16(&s[3]) != dec->width ||
+       (comps != 1 && comps != 3) || st->seg_pos != 6 + comps * 3)
+        return false;
+
+    for(uint32_t c = 0; c < comps; c++) {
+        uint8_t sampling = s[7 + c * 3];
+        st->comp_qt[c] = s[8 + c * 3];
+        if(st->comp_qt[c] > 3)
+            return false;
+
+        if(c == 0) {
+            st->h = sampling >> 4;
+            st->v = sampling & 0x0F;
+        } else if(sampling != 0x11) {
+            return false;
+        }
+    }
+
+    // a single component scan has one block per MCU whatever its sampling
+    if(comps == 1)
+        st->h = st->v = 1;
+    if(st->h < 1 || st->h > 2 || st->v < 1 || st->v > 2)
+        return false;
+
+    st->comps = comps;
+    st->mcus_x = (dec->width + st->h * 8 - 1) / (st->h * 8);
+    st->mcus_y = (dec->height + st->v * 8 - 1) / (st->v * 8);
+    st->frame = true;
+    return true;
+}
+
+// SOS: one scan of all components, in frame order
+static bool VidJpeg_Scan(VidJpeg_State* st) {
+    const uint8_t* s = st->seg;
+
+    if(!st->frame || s[0] != st->comps || st->seg_pos != 4 + st->comps * 2)
+        return false;
+
+    for(uint32_t c = 0; c < st->comps; c++) {
+        uint8_t tables = s[2 + c * 2];
+        st->comp_dc[c] = tables >> 4;
+        st->comp_ac[c] = 2 + (tables & 0x0F);
+        if((tables >> 4) > 1 || (tables & 0x0F) > 1)
+            return false;
+    }
+
+    // spectral selection 0..63, no successive approximation
+    const uint8_t* p = &s[1 + st->comps * 2];
+    if(p[0] != 0 || p[1] != 63 || p[2] != 0)
+        return false;
+
+    st->restart_left = st->restart_interval;
+    return true;
+}
+
+// One byte of a DQT or DHT segment
+static bool VidJpeg_TableByte(VidJpeg_State* st, uint8_t b) {
+    if(st->seg_pos == 0) {
+        st->table = b;
+        st->seg_pos = 1;
+        if(st->marker == VID_JPEG_DQT)
+            return (b >> 4) == 0 && (b & 0x0F) <= 3; // 8-bit values
+        return (b >> 4) <= 1 && (b & 0x0F) <= 1;
+    }
+
+    if(st->marker == VID_JPEG_DQT) {
+        st->qt[st->table & 0x0F][st->seg_pos - 1] = b;
+        if(++st->seg_pos == 65)
+            st->seg_pos = 0;
+        return true;
+    }
+
+    VidJpeg_Huff* h = &st->huff[(st->table >> 4) * 2 + (st->table & 0x0F)];
+    if(st->seg_pos <= 16) {
+        st->counts[st->seg_pos - 1] = b;
+        st->table_len += b;
+        st->seg_pos++;
+        if(st->table_len > 256)
+            return false;
+    } else {
+        h->values[st->seg_pos - 17] = b;
+        st->seg_pos++;
+    }
+
+    if(st->seg_pos == 17 + st->table_len) {
+        st->seg_pos = 0;
+        st->table_len = 0;
+        return VidJpeg_BuildHuff(h, st->counts);
+    }
+    return true;
+}
+
+// Read segment bytes; false on a corrupt or unsupported segment
+static bool VidJpeg_Segment(VidDecoder* dec, VidJpeg_State* st, VidCodec_In* in) {
+    while(st->seg_left > 0 && in->ptr < in->end) {
+        uint8_t m = st->marker;
+        if(m == VID_JPEG_DQT || m == VID_JPEG_DHT) {
+            if(!VidJpeg_TableByte(st, *in->ptr++))
+                return false;
+        } else if(m == VID_JPEG_SOF0 || m == VID_JPEG_SOF1 || m == VID_JPEG_SOS || m == VID_JPEG_DRI) {
+            if(st->seg_pos == VID_JPEG_SEGMENT_MAX)
+                return false;
+            st->seg[st->seg_pos++] = *in->ptr++;
+        } else {
+            // APPn, COM, ...: skipped
+            uint32_t n = in->end - in->ptr;
+            if(n > st->seg_left)
+                n = st->seg_left;
+            in->ptr += n;
+            st->seg_left -= n;
+            continue;
+        }
+        st->seg_left--;
+    }
+
+    if(st->seg_left > 0)
+        return true;
+
+    st->step = VidJpeg_MARKER;
+    switch(st->marker) {
+    case VID_JPEG_DQT:
+    case VID_JPEG_DHT:
+        return st->seg_pos == 0;
+    case VID_JPEG_SOF0:
+    case VID_JPEG_SOF1:
+        return VidJpeg_Frame(dec, st);
+    case VID_JPEG_DRI:
+        st->restart_interval = Vid_ReadU16(st->seg);
+        return st->seg_pos == 2;
+    case VID_JPEG_SOS:
+        if(!VidJpeg_Scan(st))
+            return false;
+        st->step = VidJpeg_SCAN;
+        return true;
+    default:
+        return true;
+    }
+}
+
+// Buffer entropy coded bytes up to 25..32 bits. Stops at a marker, which is left in the input,
+// and at a 0xFF that may start one until the next byte is in.
+static void VidJpeg_Fill(VidJpeg_State* st, VidCodec_In* in) {
+    while(st->count <= 24) {
+        if(st->at_marker) {
+            st->count += 8; // zero bits past the end of the data
+            continue;
+        }
+
+        if(in->ptr == in->end)
+            return;
+
+        uint8_t b = in->ptr[0];
+        if(b == 0xFF) {
+            if(in->end - in->ptr < 2)
+                return;
+            if(in->ptr[1] != 0x00) {
+                st->at_marker = true;
+                continue;
+            }
+            in->ptr++; // stuffed zero
+        }
+
+        in->ptr++;
+        st->bits |= (uint32_t) b << (24 - st->count);
+        st->count += 8;
+    }
+}
+
+// Next Huffman symbol, -1 for an invalid code; at least 16 bits are buffered
+static int32_t VidJpeg_Symbol(VidJpeg_State* st, const VidJpeg_Huff* h) {
+    uint32_t entry = h->lookup[st->bits >> 24];
+    uint32_t len = entry >> 8;
+
+    if(len == 0) {
+        for(len = 9; len <= 16; len++) {
+            int32_t code = st->bits >> (32 - len);
+            if(code <= h->maxcode[len]) {
+                entry = h->values[code + h->valoff[len]];
+                break;
+            }
+        }
+        if(len > 16)
+            return -1;
+    }
+
+    st->bits <<= len;
+    st->count -= len;
+    return entry & 0xFF;
+}
+
+// Signed value of `size` extra bits (1..15); at least `size` bits are buffered
+static int32_t VidJpeg_Extend(VidJpeg_State* st, uint32_t size) {
+    int32_t v = st->bits >> (32 - size);
+    st->bits <<= size;
+    st->count -= size;
+    return (v < (1 << (size - 1))) ? v - (1 << size) + 1 : v;
+}
+
+// Dequantized coefficient. Those of valid 8-bit data stay within +-1152; the limit keeps the
+// IDCT of corrupt data from overflowing.
+static inline int32_t VidJpeg_Coef(int32_t v) {
+    return (v < -2047) ? -2047 : (v > 2047) ? 2047 : v;
+}
+
+// Integer IDCT (the LLM algorithm, as libjpeg's jidctint.c) of one block into 8-bit samples
+#define VID_JPEG_CONST_BITS     13
+#define VID_JPEG_PASS1_BITS     2
+#define VID_JPEG_FIX(x)         ((int32_t) ((x) * (1 << VID_JPEG_CONST_BITS) + 0.5))
+
+static inline uint8_t VidJpeg_Clamp(int32_t v) {
+    return (v < 0) ? 0 : (v > 255) ? 255 : v;
+}
+
+#define VID_JPEG_IDCT_1D(s0, s1, s2, s3, s4, s5, s6, s7) \
+    int32_t z1 = ((s2) + (s6)) * VID_JPEG_FIX(0.541196100); \
+    int32_t t2 = z1 - (s6) * VID_JPEG_FIX(1.847759065); \
+    int32_t t3 = z1 + (s2) * VID_JPEG_FIX(0.765366865); \
+    int32_t t0 = ((s0) + (s4)) * (1 << VID_JPEG_CONST_BITS); \
+    int32_t t1 = ((s0) - (s4)) * (1 << VID_JPEG_CONST_BITS); \
+    int32_t e10 = t0 + t3, e13 = t0 - t3, e11 = t1 + t2, e12 = t1 - t2; \
+    t0 = (s7); t1 = (s5); t2 = (s3); t3 = (s1); \
+    z1 = t0 + t3; \
+    int32_t z2 = t1 + t2, z3 = t0 + t2, z4 = t1 + t3; \
+    int32_t z5 = (z3 + z4) * VID_JPEG_FIX(1.175875602); \
+    t0 *= VID_JPEG_FIX(0.298631336); \
+    t1 *= VID_JPEG_FIX(2.053119869); \
+    t2 *= VID_JPEG_FIX(3.072711026); \
+    t3 *= VID_JPEG_FIX(1.501321110); \
+    z1 *= -VID_JPEG_FIX(0.899976223); \
+    z2 *= -VID_JPEG_FIX(2.562915447); \
+    z3 = z3 * -VID_JPEG_FIX(1.961570560) + z5; \
+    z4 = z4 * -VID_JPEG_FIX(0.390180644) + z5; \
+    t0 += z1 + z3; \
+    t1 += z2 + z4; \
+    t2 += z2 + z3; \
+    t3 += z1 + z4;
+
+static void VidJpeg_Idct(const int32_t* coef, uint8_t* dst, uint32_t stride) {
+    int32_t ws[64];
+
+    // columns, scaled up by PASS1_BITS
+    for(int32_t c = 0; c < 8; c++) {
+        const int32_t* in = &coef[c];
+        int32_t* w = &ws[c];
+
+        if((in[8] | in[16] | in[24] | in[32] | in[40] | in[48] | in[56]) == 0) {
+            int32_t dc = in[0] * (1 << VID_JPEG_PASS1_BITS);
+            for(int32_t r = 0; r < 8; r++)
+                w[r * 8] = dc;
+            continue;
+        }
+
+        VID_JPEG_IDCT_1D(in[0], in[8], in[16], in[24], in[32], in[40], in[48], in[56])
+        const int32_t shift = VID_JPEG_CONST_BITS - VID_JPEG_PASS1_BITS;
+        const int32_t round = 1 << (shift - 1);
+        w[0] = (e10 + t3 + round) >> shift;
+        w[56] = (e10 - t3 + round) >> shift;
+        w[8] = (e11 + t2 + round) >> shift;
+        w[48] = (e11 - t2 + round) >> shift;
+        w[16] = (e12 + t1 + round) >> shift;
+        w[40] = (e12 - t1 + round) >> shift;
+        w[24] = (e13 + t0 + round) >> shift;
+        w[32] = (e13 - t0 + round) >> shift;
+    }
+
+    // rows, scaled down by PASS1_BITS and the IDCT's factor of 8, level shifted by 128
+    for(int32_t r = 0; r < 8; r++) {
+        const int32_t* w = &ws[r * 8];
+        uint8_t* out = &dst[r * stride];
+
+        if((w[1] | w[2] | w[3] | w[4] | w[5] | w[6] | w[7]) == 0) {
+            uint8_t v = VidJpeg_Clamp(((w[0] + (1 << (VID_JPEG_PASS1_BITS + 2))) >> (VID_JPEG_PASS1_BITS + 3)) + 128);
+            memset(out, v, 8);
+            continue;
+        }
+
+        VID_JPEG_IDCT_1D(w[0], w[1], w[2], w[3], w[4], w[5], w[6], w[7])
+        const int32_t shift = VID_JPEG_CONST_BITS + VID_JPEG_PASS1_BITS + 3;
+        const int32_t round = (1 << (shift - 1)) + (128 << shift);
+        out[0] = VidJpeg_Clamp((e10 + t3 + round) >> shift);
+        out[7] = VidJpeg_Clamp((e10 - t3 + round) >> shift);
+        out[1] = VidJpeg_Clamp((e11 + t2 + round) >> shift);
+        out[6] = VidJpeg_Clamp((e11 - t2 + round) >> shift);
+        out[2] = VidJpeg_Clamp((e12 + t1 + round) >> shift);
+        out[5] = VidJpeg_Clamp((e12 - t1 + round) >> shift);
+        out[3] = VidJpeg_Clamp((e13 + t0 + round) >> shift);
+        out[4] = VidJpeg_Clamp((e13 - t0 + round) >> shift);
+    }
+}
+
+// Component of block `b` of the MCU
+static uint32_t VidJpeg_BlockComp(const VidJpeg_State* st, uint32_t b) {
+    uint32_t luma = st->h * st->v;
+    return (b < luma) ? 0 : b - luma + 1;
+}
+
+static void VidJpeg_StoreBlock(VidJpeg_State* st, uint32_t b, bool dc_only) {
+    uint8_t* dst = &st->samples[b * 64];  // chroma blocks follow the luma ones
+    uint32_t stride = 8;
+
+    if(b < (uint32_t) st->h * st->v) {
+        stride = st->h * 8;
+        dst = &st->samples[(b / st->h) * 8 * stride + (b % st->h) * 8];
+    }
+
+    if(dc_only) {
+        uint8_t v = VidJpeg_Clamp(((st->coef[0] + 4) >> 3) + 128);
+        for(uint32_t r = 0; r < 8; r++)
+            memset(&dst[r * stride], v, 8);
+    } else {
+        VidJpeg_Idct(st->coef, dst, stride);
+    }
+}
+
+// Decode the rest of the current MCU; false when short of input, *corrupt set on bad data
+static bool VidJpeg_DecodeMcu(VidJpeg_State* st, VidCodec_In* in, bool* corrupt) {
+    uint32_t blocks = st->h * st->v + (st->comps == 3 ? 2 : 0);
+
+    while(st->block < blocks) {
+        uint32_t c = VidJpeg_BlockComp(st, st->block);
+        const uint8_t* q = st->qt[st->comp_qt[c]];
+
+        if(st->symbol < 0) {
+            VidJpeg_Fill(st, in);
+            if(st->count < 16 && !st->at_marker)
+                return false;
+
+            if(st->k == 0)
+                memset(st->coef, 0, sizeof(st->coef));
+            st->symbol = VidJpeg_Symbol(st, &st->huff[st->k == 0 ? st->comp_dc[c] : st->comp_ac[c]]);
+            if(st->symbol < 0) {
+                *corrupt = true;
+                return false;
+            }
+        }
+
+        uint32_t size = st->symbol & 0x0F;
+        if(size > 0) {
+            VidJpeg_Fill(st, in);
+            if(st->count < size && !st->at_marker)
+                return false;
+        }
+
+        if(st->k == 0) {
+            // DC: difference from the component's previous block
+            if(size > 11) {
+                *corrupt = true;
+                return false;
+            }
+            if(size > 0)
+                st->dc[c] += VidJpeg_Extend(st, size);
+            st->coef[0] = VidJpeg_Coef(st->dc[c] * q[0]);
+            st->k = 1;
+        } else {
+            uint32_t run = st->symbol >> 4;
+            if(size == 0 && run != 15) {
+                st->k = 64; // end of block
+            } else {
+                st->k += run;
+                if(st->k > 63) {
+                    *corrupt = true;
+                    return false;
+                }
+                if(size > 0)
+                    st->coef[VidJpeg_Zigzag[st->k]] = VidJpeg_Coef(VidJpeg_Extend(st, size) * q[st->k]);
+                st->k++;
+            }
+        }
+        st->symbol = -1;
+
+        if(st->k == 64) {
+            bool dc_only = true;
+            for(uint32_t i = 1; i < 64 && dc_only; i++)
+                dc_only = st->coef[i] == 0;
+            VidJpeg_StoreBlock(st, st->block, dc_only);
+            st->block++;
+            st->k = 0;
+        }
+    }
+
+    return true;
+}
+
+// Convert the decoded MCU to the RGB565 pixels of its tile, clipped to the frame
+static void VidJpeg_ConvertMcu(VidDecoder* dec, VidJpeg_State* st) {
+    uint32_t mcu_w = st->h * 8;
+    uint32_t mcu_h = st->v * 8;
+    VidRect* t = &st->tile;
+
+    t->x = st->mcu_x * mcu_w;
+    t->y = st->mcu_y * mcu_h;
+    uint32_t left = dec->width - t->x;
+    uint32_t below = dec->height - t->y;
+    t->w = (left < mcu_w) ? left : mcu_w;
+    t->h = (below < mcu_h) ? below : mcu_h;
+
+    const uint8_t* cb = &st->samples[st->h * st->v * 64];
+    const uint8_t* cr = cb + 64;
+    uint8_t* p = st->pixels;
+
+    for(uint32_t y = 0; y < t->h; y++) {
+        const uint8_t* luma = &st->samples[y * mcu_w];
+        uint32_t c_row = (y / st->v) * 8;
+        uint32_t x = 0;
+
+        if(st->comps == 1) {
+            for(; x < t->w; x++, p += 2) {
+                uint32_t pair = VidYuv_Pair(luma[x], luma[x], 0, 0);
+                memcpy(p, &pair, 2);
+            }
+            continue;
+        }
+
+        // pixels that share chroma are converted in pairs
+        if(st->h == 2) {
+            for(; x + 2 <= t->w; x += 2, p += 4) {
+                uint32_t i = c_row + x / 2;
+                uint32_t pair = VidYuv_Pair(luma[x], luma[x + 1], cb[i] - 128, cr[i] - 128);
+                memcpy(p, &pair, 4); // unaligned word store
+            }
+        }
+
+        for(; x < t->w; x++, p += 2) {
+            uint32_t i = c_row + x / st->h;
+            uint32_t pair = VidYuv_Pair(luma[x], luma[x], cb[i] - 128, cr[i] - 128);
+            memcpy(p, &pair, 2);
+        }
+    }
+}
+
+int32_t VidJpeg_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    VidJpeg_State* st = &dec->s.jpeg;
+    uint8_t* p = out;
+    uint8_t* end = out + out_cap;
+
+    while(p < end) {
+        switch(st->step) {
+        case VidJpeg_MARKER: {
+            // fill bytes (0xFF) may precede a marker
+            while(in->end - in->ptr >= 2 && in->ptr[0] == 0xFF && in->ptr[1] == 0xFF)
+                in->ptr++;
+            if(in->end - in->ptr < 2)
+                return p - out;
+            if(in->ptr[0] != 0xFF)
+                return -1;
+
+            uint8_t m = in->ptr[1];
+            in->ptr += 2;
+            if(m == VID_JPEG_SOI || (m >= VID_JPEG_RST0 && m <= VID_JPEG_RST7))
+                break;
+            if(m == VID_JPEG_EOI)
+                return -1; // no scan
+            if(m >= 0xC2 && m <= 0xCF && m != VID_JPEG_DHT && m != 0xC8 && m != 0xCC)
+                return -1; // SOF2..SOF15: progressive, lossless or arithmetic coded
+
+            st->marker = m;
+            st->step = VidJpeg_LENGTH;
+            break;
+        }
+
+        case VidJpeg_LENGTH:
+            if(in->end - in->ptr < 2)
+                return p - out;
+            st->seg_left = Vid_ReadU16(in->ptr);
+            in->ptr += 2;
+            if(st->seg_left < 2)
+                return -1;
+            st->seg_left -= 2;
+            st->seg_pos = 0;
+            st->table_len = 0;
+            st->step = VidJpeg_SEGMENT;
+            break;
+
+        case VidJpeg_SEGMENT:
+            if(!VidJpeg_Segment(dec, st, in))
+                return -1;
+            if(st->step == VidJpeg_SEGMENT)
+                return p - out; // short of input
+            break;
+
+        case VidJpeg_SCAN: {
+            bool corrupt = false;
+            if(!VidJpeg_DecodeMcu(st, in, &corrupt))
+                return corrupt ? -1 : p - out;
+
+            VidJpeg_ConvertMcu(dec, st);
+            st->block = 0;
+            st->emit_pos = 0;
+            st->step = VidJpeg_EMIT;
+            break;
+        }
+
+        case VidJpeg_EMIT: {
+            uint32_t len = (uint32_t) st->tile.w * st->tile.h * 2;
+
+            if(st->emit_pos == 0) {
+                // a band never spans two tiles: they are drawn in separate windows
+                if(p > out) {
+                    dec->band_break = true;
+                    return p - out;
+                }
+                dec->rect = st->tile;
+                dec->rect_new = true;
+            }
+
+            uint32_t n = len - st->emit_pos;
+            if(n > (uint32_t) (end - p))
+                n = end - p;
+            memcpy(p, &st->pixels[st->emit_pos], n);
+            p += n;
+            st->emit_pos += n;
+            if(st->emit_pos < len)
+                break;
+
+            if(++st->mcu_x == st->mcus_x) {
+                st->mcu_x = 0;
+                st->mcu_y++;
+            }
+
+            st->step = VidJpeg_SCAN;
+            if(st->restart_interval != 0 && --st->restart_left == 0 && st->mcu_y < st->mcus_y)
+                st->step = VidJpeg_RESTART;
+
+            // the band ends with its tile: the caller may pass the rest of this band to the next
+            // call, which could emit the next tile after running short of input
+            dec->band_break = true;
+            return p - out;
+        }
+
+        case VidJpeg_RESTART:
+            // the data before the marker ends within the buffered bits
+            while(in->end - in->ptr >= 2 && in->ptr[0] == 0xFF && in->ptr[1] == 0xFF)
+                in->ptr++;
+            if(in->end - in->ptr < 2)
+                return p - out;
+            if(in->ptr[0] != 0xFF || in->ptr[1] < VID_JPEG_RST0 || in->ptr[1] > VID_JPEG_RST7)
+                return -1;
+
+            in->ptr += 2;
+            st->bits = 0;
+            st->count = 0;
+            st->at_marker = false;
+            memset(st->dc, 0, sizeof(st->dc));
+            st->restart_left = st->restart_interval;
+            st->step = VidJpeg_SCAN;
+            break;
+
+        default:
+            return -1;
+        }
+    }
+
+    return p - out;
+}
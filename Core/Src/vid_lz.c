@@ -0,0 +1,129 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+// Append output to the history window
+static void VidLz_Keep(VidLz_State* st, const uint8_t* src, uint32_t n) {
+    if(n > VID_LZ_WINDOW) {
+        src += n - VID_LZ_WINDOW;
+        st->total += n - VID_LZ_WINDOW;
+        n = VID_LZ_WINDOW;
+    }
+
+    uint32_t pos = st->total % VID_LZ_WINDOW;
+    uint32_t first = VID_LZ_WINDOW - pos;
+    if(first > n)
+        first = n;
+
+    memcpy(&st->window[pos], src, first);
+    memcpy(&st->window[0], src + first, n - first);
+    st->total += n;
+}
+
+// Next byte of an extended length: 255 continues; false when the input is empty
+static bool VidLz_ReadLength(VidCodec_In* in, uint32_t* len, bool* more) {
+    if(in->ptr == in->end)
+        return false;
+
+    uint8_t b = *in->ptr++;
+    *len += b;
+    *more = (b == 255);
+    return true;
+}
+
+int32_t VidLz_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    VidLz_State* st = &dec->s.lz;
+    uint8_t* p = out;
+    uint8_t* end = out + out_cap;
+    bool more;
+
+    while(p < end) {
+        switch(st->step) {
+        case VidLz_TOKEN: {
+            if(in->ptr == in->end)
+                return p - out;
+
+            uint8_t token = *in->ptr++;
+            st->lit_left = token >> 4;
+            st->match_left = (token & 0x0F) + VID_LZ_MIN_MATCH;
+            st->step = (st->lit_left == 15) ? VidLz_LITERAL_LENGTH : VidLz_LITERALS;
+            break;
+        }
+
+        case VidLz_LITERAL_LENGTH:
+            if(!VidLz_ReadLength(in, &st->lit_left, &more))
+                return p - out;
+            if(!more)
+                st->step = VidLz_LITERALS;
+            break;
+
+        case VidLz_LITERALS: {
+            uint32_t n = end - p;
+            uint32_t avail = in->end - in->ptr;
+            if(n > st->lit_left)
+                n = st->lit_left;
+            if(n > avail)
+                n = avail;
+
+            memcpy(p, in->ptr, n);
+            VidLz_Keep(st, p, n);
+            in->ptr += n;
+            p += n;
+            st->lit_left -= n;
+
+            if(st->lit_left == 0)
+                st->step = VidLz_OFFSET;
+            else if(n == 0)
+                return p - out; // short of input
+            break;
+        }
+
+        case VidLz_OFFSET:
+            if(in->end - in->ptr < 2)
+                return p - out;
+
+            st->offset = Vid_ReadU16(in->ptr);
+            in->ptr += 2;
+            if(st->offset == 0 || st->offset > VID_LZ_WINDOW || st->offset > st->total)
+                return -1;
+
+            st->step = (st->match_left == 15 + VID_LZ_MIN_MATCH) ? VidLz_MATCH_LENGTH : VidLz_MATCH;
+            break;
+
+        case VidLz_MATCH_LENGTH:
+            if(!VidLz_ReadLength(in, &st->match_left, &more))
+                return p - out;
+            if(!more)
+                st->step = VidLz_MATCH;
+            break;
+
+        case VidLz_MATCH: {
+            uint32_t n = end - p;
+            if(n > st->match_left)
+                n = st->match_left;
+
+            // the first `offset` bytes come from the window, the rest repeat them
+            uint32_t head = (n < st->offset) ? n : st->offset;
+            uint32_t src = (st->total - st->offset) % VID_LZ_WINDOW;
+            uint32_t first = VID_LZ_WINDOW - src;
+            if(first > head)
+                first = head;
+
+            memcpy(p, &st->window[src], first);
+            memcpy(p + first, &st->window[0], head - first);
+            for(uint32_t i = head; i < n; i++)
+                p[i] = p[i - st->offset];
+
+            VidLz_Keep(st, p, n);
+            p += n;
+            st->match_left -= n;
+
+            if(st->match_left == 0)
+                st->step = VidLz_TOKEN;
+            break;
+        }
+        }
+    }
+
+    return p - out;
+}
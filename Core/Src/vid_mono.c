@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+// One bit per pixel: nibbles are expanded through a table of 4 pixels, like the font bits of
+// ST7735_WriteChar but into the band buffer
+static uint32_t VidMono_Bits(VidMono_State* st, VidCodec_In* in, uint16_t* dst, uint32_t pixels) {
+    uint32_t i = 0;
+
+    for(;;) {
+        if(st->bits_left == 0) {
+            if(in->ptr == in->end)
+                break;
+
+            // whole bytes while they fit
+            if(pixels - i >= 8) {
+                uint32_t n = (pixels - i) / 8;
+                uint32_t avail = in->end - in->ptr;
+                if(n > avail)
+                    n = avail;
+
+                for(uint32_t k = 0; k < n; k++, i += 8) {
+                    uint8_t b = in->ptr[k];
+                    memcpy(&dst[i], st->quads[b >> 4], 8);
+                    memcpy(&dst[i + 4], st->quads[b & 0x0F], 8);
+                }
+                in->ptr += n;
+                continue;
+            }
+
+            if(i == pixels)
+                break;
+
+            st->bits = *in->ptr++;
+            st->bits_left = 8;
+        }
+
+        // part of a byte at the end of the output
+        for(; st->bits_left > 0 && i < pixels; st->bits_left--)
+            memcpy(&dst[i++], st->colors[(st->bits >> (st->bits_left - 1)) & 1], 2);
+
+        if(i == pixels)
+            break;
+    }
+
+    return i;
+}
+
+// Alternating runs of bg and fg; false on a corrupt payload
+static bool VidMono_Runs(VidMono_State* st, VidCodec_In* in, uint16_t* dst, uint32_t pixels, uint32_t* produced) {
+    uint32_t i = 0;
+
+    while(i < pixels) {
+        if(st->run_left == 0) {
+            uint32_t len = 0;
+            uint32_t k = 0;
+            for(;; k++) {
+                if(k == VID_MONO_VARINT_MAX)
+                    return false;
+                if(in->ptr + k == in->end) {
+                    *produced = i; // varint continues in the next chunk
+                    return true;
+                }
+
+                len |= (uint32_t) (in->ptr[k] & 0x7F) << (7 * k);
+                if(!(in->ptr[k] & 0x80))
+                    break;
+            }
+            in->ptr += k + 1;
+
+            // the first run is bg: it starts with run_fg set
+            st->run_fg = !st->run_fg;
+            st->run_left = len;
+            continue;
+        }
+
+        uint32_t n = pixels - i;
+        if(n > st->run_left)
+            n = st->run_left;
+
+        VidCodec_Fill((uint8_t*) &dst[i], st->colors[st->run_fg], n * 2);
+        i += n;
+        st->run_left -= n;
+    }
+
+    *produced = i;
+    return true;
+}
+
+int32_t VidMono_Decode(VidMono_State* st, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    if(!st->header_done) {
+        if(in->end - in->ptr < VID_MONO_HEADER_LEN)
+            return 0;
+
+        memcpy(st->colors[1], &in->ptr[0], 2);
+        memcpy(st->colors[0], &in->ptr[2], 2);
+        st->coding = in->ptr[4];
+        in->ptr += VID_MONO_HEADER_LEN;
+        st->header_done = true;
+        st->run_fg = true;
+
+        if(st->coding == VID_MONO_BITS) {
+            for(uint32_t n = 0; n < 16; n++)
+                for(uint32_t j = 0; j < 4; j++)
+                    memcpy(&st->quads[n][j], st->colors[(n >> (3 - j)) & 1], 2);
+        } else if(st->coding != VID_MONO_RUNS) {
+            return -1;
+        }
+    }
+
+    uint16_t* dst = (uint16_t*) out;
+    uint32_t pixels = out_cap / 2;
+    uint32_t produced;
+
+    if(st->coding == VID_MONO_BITS)
+        produced = VidMono_Bits(st, in, dst, pixels);
+    else if(!VidMono_Runs(st, in, dst, pixels, &produced))
+        return -1;
+
+    return produced * 2;
+}
@@ -0,0 +1,166 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+bool VidRef_Reset(VidRef* ref, uint16_t width, uint16_t height) {
+    uint32_t lines = VID_REF_LINES(height);
+
+    ref->width = ref->height = 0;
+    if(width % VID_MOTION_BLOCK != 0 || height % VID_MOTION_BLOCK != 0 || (uint32_t) width * lines * 2 > ref->size)
+        return false;
+
+    ref->width = width;
+    ref->height = height;
+    ref->lines = lines;
+    ref->top = 0;
+    return true;
+}
+
+void VidRef_Write(VidRef* ref, const VidRect* rect, uint32_t pos, const uint8_t* src, uint32_t len) {
+    uint32_t line_len = (uint32_t) rect->w * 2;
+
+    if(ref->width == 0)
+        return;
+
+    while(len > 0) {
+        uint32_t y = pos / line_len;
+        uint32_t x = pos % line_len;
+        uint32_t n = line_len - x;
+        if(n > len)
+            n = len;
+        if(y >= rect->h)
+            return;
+
+        memcpy(VidRef_Line(ref, rect->y + y) + rect->x * 2 + x, src, n);
+        src += n;
+        pos += n;
+        len -= n;
+    }
+}
+
+// Copy the block at (x, y) of the previous frame to `dst` (first line of the block in the ring)
+static bool VidMotion_CopyBlock(const VidRef* ref, uint8_t** dst, int32_t x, int32_t y) {
+    if(x < 0 || y < 0 || x + VID_MOTION_BLOCK > ref->width || y + VID_MOTION_BLOCK > ref->height)
+        return false;
+
+    for(int32_t j = 0; j < VID_MOTION_BLOCK; j++)
+        memcpy(dst[j], VidRef_Line(ref, y + j) + x * 2, VID_MOTION_BLOCK * 2);
+
+    return true;
+}
+
+// Decode the blocks of the current row into the ring; false on a corrupt payload
+static bool VidMotion_DecodeRow(VidRef* ref, VidMotion_State* st, VidCodec_In* in) {
+    uint32_t blocks = ref->width / VID_MOTION_BLOCK;
+    int32_t y = st->row * VID_MOTION_BLOCK;
+    uint8_t* dst[VID_MOTION_BLOCK];
+
+    // decoded rows go two block rows up, see VID_REF_LINES
+    for(int32_t j = 0; j < VID_MOTION_BLOCK; j++)
+        dst[j] = VidRef_Line(ref, y + j - 2 * VID_MOTION_BLOCK);
+
+    while(st->block < blocks) {
+        int32_t x = st->block * VID_MOTION_BLOCK;
+        uint8_t* block_dst[VID_MOTION_BLOCK];
+        for(int32_t j = 0; j < VID_MOTION_BLOCK; j++)
+            block_dst[j] = dst[j] + x * 2;
+
+        if(st->raw_left > 0) {
+            uint32_t i = VID_MOTION_RAW_LEN - st->raw_left;
+            uint32_t n = VID_MOTION_BLOCK * 2 - i % (VID_MOTION_BLOCK * 2);
+            uint32_t avail = in->end - in->ptr;
+            if(n > avail)
+                n = avail;
+            if(n == 0)
+                return true;
+
+            memcpy(block_dst[i / (VID_MOTION_BLOCK * 2)] + i % (VID_MOTION_BLOCK * 2), in->ptr, n);
+            in->ptr += n;
+            st->raw_left -= n;
+            if(st->raw_left == 0)
+                st->block++;
+            continue;
+        }
+
+        if(st->skip_left > 0) {
+            VidMotion_CopyBlock(ref, block_dst, x, y);
+            st->skip_left--;
+            st->block++;
+            continue;
+        }
+
+        if(in->ptr == in->end)
+            return true;
+
+        uint8_t ctrl = in->ptr[0];
+        if(ctrl < VID_MOTION_RAW) {
+            st->skip_left = ctrl + 1;
+            in->ptr++;
+        } else if(ctrl == VID_MOTION_RAW) {
+            st->raw_left = VID_MOTION_RAW_LEN;
+            in->ptr++;
+        } else if(ctrl == VID_MOTION_COPY) {
+            if(in->end - in->ptr < 2)
+                return true;
+
+            // 4-bit two's complement components
+            int32_t dx = (int8_t) (in->ptr[1] & 0xF0) >> 4;
+            int32_t dy = (int8_t) (in->ptr[1] << 4) >> 4;
+            in->ptr += 2;
+
+            if(!VidMotion_CopyBlock(ref, block_dst, x + dx, y + dy))
+                return false;
+            st->block++;
+        } else {
+            return false;
+        }
+    }
+
+    st->emit = true;
+    st->emit_pos = 0;
+    return true;
+}
+
+int32_t VidMotion_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    VidMotion_State* st = &dec->s.motion;
+    VidRef* ref = dec->ref;
+    uint32_t line_len = (uint32_t) ref->width * 2;
+    uint32_t row_len = line_len * VID_MOTION_BLOCK;
+    uint8_t* p = out;
+    uint8_t* end = out + out_cap;
+
+    while(p < end) {
+        if(!st->emit) {
+            if(!VidMotion_DecodeRow(ref, st, in))
+                return -1;
+            if(!st->emit)
+                break; // short of input
+        }
+
+        // copy the decoded row out in raster order
+        int32_t y = st->row * VID_MOTION_BLOCK + st->emit_pos / line_len - 2 * VID_MOTION_BLOCK;
+        uint32_t x = st->emit_pos % line_len;
+        uint32_t n = line_len - x;
+        if(n > (uint32_t) (end - p))
+            n = end - p;
+
+        memcpy(p, VidRef_Line(ref, y) + x, n);
+        p += n;
+        st->emit_pos += n;
+
+        if(st->emit_pos == row_len) {
+            st->emit = false;
+            st->block = 0;
+            st->row++;
+
+            // frame complete: it becomes the reference
+            if(st->row == ref->height / VID_MOTION_BLOCK) {
+                if(st->skip_left != 0)
+                    return -1;
+                ref->top = (ref->top + ref->lines - 2 * VID_MOTION_BLOCK) % ref->lines;
+            }
+        }
+    }
+
+    return p - out;
+}
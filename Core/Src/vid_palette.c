@@ -0,0 +1,106 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+// Palette header and colors; false on a corrupt payload. Colors may arrive over several chunks.
+static bool VidPalette_Load(VidPalette_State* st, VidCodec_In* in, uint16_t max_len) {
+    if(st->len == 0) {
+        if(in->end - in->ptr < 2)
+            return true;
+
+        st->len = Vid_ReadU16(in->ptr);
+        in->ptr += 2;
+        if(st->len == 0 || st->len > max_len)
+            return false;
+    }
+
+    // colors are copied as they are: output keeps the display's byte order
+    uint32_t n = (in->end - in->ptr) / 2;
+    if(n > (uint32_t) (st->len - st->loaded))
+        n = st->len - st->loaded;
+
+    memcpy(&st->colors[st->loaded], in->ptr, n * 2);
+    in->ptr += n * 2;
+    st->loaded += n;
+    return true;
+}
+
+int32_t VidI8_Decode(VidPalette_State* st, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    if(st->len == 0 || st->loaded < st->len) {
+        if(!VidPalette_Load(st, in, VID_PALETTE_MAX))
+            return -1;
+        if(st->len == 0 || st->loaded < st->len)
+            return 0;
+    }
+
+    // one lookup per pixel; `out` is 2-byte aligned
+    uint32_t n = out_cap / 2;
+    uint32_t avail = in->end - in->ptr;
+    if(n > avail)
+        n = avail;
+
+    const uint8_t* src = in->ptr;
+    const uint16_t* colors = st->colors;
+    uint16_t* dst = (uint16_t*) out;
+    uint32_t i = 0;
+
+    for(; i + 4 <= n; i += 4) {
+        dst[i] = colors[src[i]];
+        dst[i + 1] = colors[src[i + 1]];
+        dst[i + 2] = colors[src[i + 2]];
+        dst[i + 3] = colors[src[i + 3]];
+    }
+    for(; i < n; i++)
+        dst[i] = colors[src[i]];
+
+    in->ptr += n;
+    return n * 2;
+}
+
+int32_t VidI4_Decode(VidPalette_State* st, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    const uint16_t* colors = st->colors;
+
+    if(st->len == 0 || st->loaded < st->len) {
+        if(!VidPalette_Load(st, in, VID_I4_PALETTE_MAX))
+            return -1;
+        if(st->len == 0 || st->loaded < st->len)
+            return 0;
+
+        // pair table: each index byte expands to its two pixels with one word store
+        for(uint32_t i = 0; i < 256; i++) {
+            uint16_t pair[2] = { colors[i >> 4], colors[i & 0x0F] };
+            memcpy(&st->pairs[i], pair, sizeof(pair));
+        }
+    }
+
+    uint32_t pixels = out_cap / 2;
+    uint16_t* dst = (uint16_t*) out;
+    uint32_t i = 0;
+
+    // low pixel of the byte that ended the previous call
+    if(st->half && pixels > 0) {
+        dst[i++] = st->half_color;
+        st->half = false;
+    }
+
+    uint32_t n = (pixels - i) / 2;
+    uint32_t avail = in->end - in->ptr;
+    if(n > avail)
+        n = avail;
+
+    const uint8_t* src = in->ptr;
+    const uint32_t* pairs = st->pairs;
+    for(uint32_t k = 0; k < n; k++, i += 2)
+        memcpy(&dst[i], &pairs[src[k]], sizeof(uint32_t)); // unaligned word store
+    in->ptr += n;
+
+    // one pixel of room left: split the next byte
+    if(i < pixels && in->ptr < in->end) {
+        uint8_t b = *in->ptr++;
+        dst[i++] = colors[b >> 4];
+        st->half = true;
+        st->half_color = colors[b & 0x0F];
+    }
+
+    return i * 2;
+}
@@ -0,0 +1,59 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+#define VID_RLE_LITERAL     0x80
+#define VID_RLE_COUNT_MASK  0x7F
+#define VID_RLE_BLOCK       2       // bytes per pixel
+
+int32_t VidRle_Decode(VidRle_State* st, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    uint8_t* p = out;
+    uint8_t* end = out + out_cap;
+
+    while(p < end) {
+        if(st->left == 0) {
+            // next control byte, and the pixel of a repeat run
+            if(in->ptr >= in->end)
+                break;
+
+            uint8_t ctrl = in->ptr[0];
+            if(ctrl & VID_RLE_LITERAL) {
+                st->literal = true;
+                in->ptr += 1;
+            } else {
+                if(in->end - in->ptr < 1 + VID_RLE_BLOCK)
+                    break;
+
+                st->literal = false;
+                st->value[0] = in->ptr[1];
+                st->value[1] = in->ptr[2];
+                in->ptr += 1 + VID_RLE_BLOCK;
+            }
+
+            st->left = (ctrl & VID_RLE_COUNT_MASK) * VID_RLE_BLOCK;
+            continue;
+        }
+
+        uint32_t n = end - p;
+        if(n > st->left)
+            n = st->left;
+
+        if(st->literal) {
+            uint32_t avail = in->end - in->ptr;
+            if(n > avail)
+                n = avail;
+            if(n == 0)
+                break;
+
+            memcpy(p, in->ptr, n);
+            in->ptr += n;
+        } else {
+            VidCodec_Fill(p, st->value, n);
+        }
+
+        p += n;
+        st->left -= n;
+    }
+
+    return p - out;
+}
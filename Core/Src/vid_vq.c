@@ -0,0 +1,83 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+int32_t VidVq_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    VidVq_State* st = &dec->s.vq;
+    uint32_t row_len = dec->width / VID_VQ_BLOCK;
+    uint8_t* p = out;
+    uint8_t* end = out + out_cap;
+
+    if(st->len == 0) {
+        if(in->end - in->ptr < 2)
+            return 0;
+
+        st->len = Vid_ReadU16(in->ptr);
+        in->ptr += 2;
+        if(st->len == 0 || st->len > VID_VQ_MAX_ENTRIES)
+            return -1;
+    }
+
+    // entries are copied as they are: output keeps the display's byte order
+    uint32_t codebook_len = (uint32_t) st->len * VID_VQ_ENTRY_LEN;
+    if(st->loaded < codebook_len) {
+        uint32_t n = codebook_len - st->loaded;
+        uint32_t avail = in->end - in->ptr;
+        if(n > avail)
+            n = avail;
+
+        memcpy(&st->codebook[st->loaded], in->ptr, n);
+        in->ptr += n;
+        st->loaded += n;
+        if(st->loaded < codebook_len)
+            return 0;
+    }
+
+    while(p < end) {
+        // indices of a block row are read on its first line and used again on the second
+        if(st->row_loaded < row_len) {
+            uint32_t n = row_len - st->row_loaded;
+            uint32_t avail = in->end - in->ptr;
+            if(n > avail)
+                n = avail;
+
+            memcpy(&st->row[st->row_loaded], in->ptr, n);
+            in->ptr += n;
+            st->row_loaded += n;
+            if(st->row_loaded < row_len)
+                break; // short of input
+        }
+
+        // top or bottom pixel pair of each entry
+        const uint8_t* codebook = &st->codebook[(st->y % VID_VQ_BLOCK) * VID_VQ_BLOCK * 2];
+        const uint8_t* idx = &st->row[st->x / VID_VQ_BLOCK];
+
+        if(st->x % VID_VQ_BLOCK == 0) {
+            uint32_t n = (dec->width - st->x) / VID_VQ_BLOCK;
+            uint32_t room = (end - p) / (VID_VQ_BLOCK * 2);
+            if(n > room)
+                n = room;
+
+            for(uint32_t k = 0; k < n; k++, p += VID_VQ_BLOCK * 2)
+                memcpy(p, &codebook[idx[k] * VID_VQ_ENTRY_LEN], VID_VQ_BLOCK * 2); // one word copy
+            st->x += n * VID_VQ_BLOCK;
+            idx += n;
+        }
+
+        // room for one pixel, or the second pixel of a split pair
+        if(st->x < dec->width && p < end) {
+            memcpy(p, &codebook[idx[0] * VID_VQ_ENTRY_LEN + (st->x % VID_VQ_BLOCK) * 2], 2);
+            p += 2;
+            st->x++;
+        }
+
+        if(st->x == dec->width) {
+            st->x = 0;
+            st->y++;
+            if(st->y % VID_VQ_BLOCK == 0)
+                st->row_loaded = 0;
+        }
+    }
+
+    return p - out;
+}
@@ -0,0 +1,139 @@
+#include <string.h>
+
+#include "vid_codec.h"
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#include "stm32f4xx.h" // CMSIS SIMD intrinsics
+#endif
+
+// Chroma terms in 2.14 fixed point, rounded: R = Y + 1.402 V', G = Y - 0.344136 U' - 0.714136 V',
+// B = Y + 1.772 U' with U' = U - 128, V' = V - 128
+#define VID_YUV_RV      22970
+#define VID_YUV_GU      (-5638)
+#define VID_YUV_GV      (-11700)
+#define VID_YUV_BU      29032
+#define VID_YUV_SHIFT   14
+#define VID_YUV_ROUND   (1 << (VID_YUV_SHIFT - 1))
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+
+// U' in the low halfword and V' in the high one, so one SMLAD gives both products of a term
+#define VID_YUV_PACK(cu, cv)    (((uint32_t) (uint16_t) (cv) << 16) | (uint16_t) (cu))
+
+// Two RGB565 pixels that share U and V, in display byte order. Every step after the chroma
+// terms works on both pixels at once in the two halfwords of a register.
+uint32_t VidYuv_Pair(uint32_t y0, uint32_t y1, int32_t u, int32_t v) {
+    uint32_t uv = __PKHBT(u, v, 16);
+    int32_t dr = (int32_t) __SMLAD(uv, VID_YUV_PACK(0, VID_YUV_RV), VID_YUV_ROUND) >> VID_YUV_SHIFT;
+    int32_t dg = (int32_t) __SMLAD(uv, VID_YUV_PACK(VID_YUV_GU, VID_YUV_GV), VID_YUV_ROUND) >> VID_YUV_SHIFT;
+    int32_t db = (int32_t) __SMLAD(uv, VID_YUV_PACK(VID_YUV_BU, 0), VID_YUV_ROUND) >> VID_YUV_SHIFT;
+
+    uint32_t yy = y0 | (y1 << 16);
+    uint32_t r = __USAT16(__QADD16(yy, __PKHBT(dr, dr, 16)), 8);
+    uint32_t g = __USAT16(__QADD16(yy, __PKHBT(dg, dg, 16)), 8);
+    uint32_t b = __USAT16(__QADD16(yy, __PKHBT(db, db, 16)), 8);
+
+    uint32_t rgb = ((r & 0x00F800F8) << 8) | ((g & 0x00FC00FC) << 3) | ((b & 0x00F800F8) >> 3);
+    return __REV16(rgb); // RGB565 is sent high byte first
+}
+
+#else
+
+static inline uint32_t VidYuv_Clamp(int32_t c) {
+    return (c < 0) ? 0 : (c > 255) ? 255 : c;
+}
+
+static inline uint16_t VidYuv_Pixel(int32_t y, int32_t dr, int32_t dg, int32_t db) {
+    return ((VidYuv_Clamp(y + dr) & 0xF8) << 8) | ((VidYuv_Clamp(y + dg) & 0xFC) << 3) | (VidYuv_Clamp(y + db) >> 3);
+}
+
+// Portable version of the SIMD kernel above, same results
+uint32_t VidYuv_Pair(uint32_t y0, uint32_t y1, int32_t u, int32_t v) {
+    int32_t dr = (VID_YUV_RV * v + VID_YUV_ROUND) >> VID_YUV_SHIFT;
+    int32_t dg = (VID_YUV_GU * u + VID_YUV_GV * v + VID_YUV_ROUND) >> VID_YUV_SHIFT;
+    int32_t db = (VID_YUV_BU * u + VID_YUV_ROUND) >> VID_YUV_SHIFT;
+
+    uint16_t c0 = VidYuv_Pixel(y0, dr, dg, db);
+    uint16_t c1 = VidYuv_Pixel(y1, dr, dg, db);
+    uint8_t bytes[4] = { c0 >> 8, c0 & 0xFF, c1 >> 8, c1 & 0xFF };
+
+    uint32_t pair;
+    memcpy(&pair, bytes, sizeof(pair));
+    return pair;
+}
+
+#endif
+
+static void VidYuv_NextPairs(const VidDecoder* dec, VidYuv_State* st, uint32_t pairs) {
+    st->x += pairs * 2;
+    if(st->x == dec->width) {
+        st->x = 0;
+        st->y++;
+    }
+}
+
+int32_t VidYuv_Decode(VidDecoder* dec, VidCodec_In* in, uint8_t* out, uint32_t out_cap) {
+    VidYuv_State* st = &dec->s.yuv;
+    uint8_t* p = out;
+    uint8_t* end = out + out_cap;
+
+    if(st->half && p < end) {
+        memcpy(p, st->half_pixel, 2);
+        p += 2;
+        st->half = false;
+    }
+
+    while(p < end) {
+        bool chroma = (st->y % 2) == 0;
+        uint32_t group = chroma ? 4 : 2;
+        uint32_t n = (dec->width - st->x) / 2;
+        uint32_t room = (end - p) / 4;
+        uint32_t avail = (in->end - in->ptr) / group;
+        if(n > room)
+            n = room;
+        if(n > avail)
+            n = avail;
+
+        if(n == 0) {
+            // room for one pixel: convert the next pair and keep its second pixel
+            if(avail > 0 && end - p == 2) {
+                const uint8_t* s = in->ptr;
+                uint8_t* uv = &st->uv[st->x];
+                if(chroma) {
+                    uv[0] = s[2];
+                    uv[1] = s[3];
+                }
+
+                uint32_t pair = VidYuv_Pair(s[0], s[1], uv[0] - 128, uv[1] - 128);
+                memcpy(p, &pair, 2);
+                memcpy(st->half_pixel, (uint8_t*) &pair + 2, 2);
+                st->half = true;
+                p += 2;
+                in->ptr += group;
+                VidYuv_NextPairs(dec, st, 1);
+            }
+            break;
+        }
+
+        const uint8_t* s = in->ptr;
+        uint8_t* uv = &st->uv[st->x];
+        if(chroma) {
+            for(uint32_t k = 0; k < n; k++, s += 4, uv += 2, p += 4) {
+                uv[0] = s[2];
+                uv[1] = s[3];
+                uint32_t pair = VidYuv_Pair(s[0], s[1], s[2] - 128, s[3] - 128);
+                memcpy(p, &pair, 4); // unaligned word store
+            }
+        } else {
+            for(uint32_t k = 0; k < n; k++, s += 2, uv += 2, p += 4) {
+                uint32_t pair = VidYuv_Pair(s[0], s[1], uv[0] - 128, uv[1] - 128);
+                memcpy(p, &pair, 4);
+            }
+        }
+
+        in->ptr = s;
+        VidYuv_NextPairs(dec, st, n);
+    }
+
+    return p - out;
+}
@@ -0,0 +1,284 @@
+// Host benchmark of the frame decoders on a converted video.bin: decode speed per frame type
+// against the SD card read speed, to see which codecs pay for their decoding.
+//
+// Build from the repository root:
+//   gcc -O2 -I Core/Inc -o codec_bench video_converter/bench/codec_bench.c Core/Src/vid_*.c
+// Run:
+//   ./codec_bench video_output/video.bin [sd_read_MBps]
+//
+// Frames are decoded as the player does: payload in SDPLAYBACK_IN_SIZE chunks, pixels in
+// SDPLAYBACK_BAND_SIZE bands. A coded frame beats a raw one when reading its payload and decoding
+// it takes less time than reading the raw pixels (SD reads and decoding are not overlapped):
+//   payload / sd + pixels / decode < pixels / sd  <=>  decode > sd * pixels / (pixels - payload)
+// which is the "needs" column. Host speeds are not the F401's; compare "needs" with the on-target
+// rate from PlaybackStats_Print(): MB/s = 84 / (cycles per pixel) * 2.
+// Motion frames are decoded against a blank reference frame: timings only.
+// Entropy coded frames count under their frame type with the entropy decoding included; the
+// "entropy" line has the entropy decoder alone, in MB/s of payload it produces (on target:
+// cycles/byte from PlaybackStats_Print(), MB/s = 84 / (cycles per byte)).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vid_codec.h"
+
+#define BENCH_IN_SIZE       1024    // SDPLAYBACK_IN_SIZE
+#define BENCH_BAND_SIZE     2048    // SDPLAYBACK_BAND_SIZE
+#define BENCH_MIN_SECONDS   1.0
+#define BENCH_SD_MBPS       1.86    // 40960 byte frame read in ~22ms over SPI2
+
+typedef struct BenchType {
+    uint32_t frames;
+    uint64_t payload_bytes;
+    uint64_t pixel_bytes;
+    double seconds;
+} BenchType;
+
+static double Bench_Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Entropy decode a whole payload in BENCH_IN_SIZE chunks; returns the bytes produced, or -1 on an error
+static int64_t Bench_Entropy(const uint16_t* lookup, const uint8_t* payload, uint32_t len, uint8_t* out, uint32_t out_cap) {
+    VidHuff_State st = { 0 };
+    uint32_t read = 0;
+    int64_t total = 0;
+
+    for(;;) {
+        uint32_t n = (len - read < BENCH_IN_SIZE) ? len - read : BENCH_IN_SIZE;
+        VidCodec_In in = { &payload[read], &payload[read + n] };
+        int32_t produced;
+
+        while((produced = VidHuff_Decode(lookup, &st, &in, &out[total], out_cap - total)) > 0)
+            total += produced;
+        if(produced < 0)
+            return -1;
+
+        read += n;
+        if(st.header_len == 4 && st.left == 0)
+            return total;
+        if(n == 0 || total == out_cap)
+            return -1;
+    }
+}
+
+// Decode one payload; returns the pixel bytes produced, -1 on an error or -2 when a band holds
+// pixels beyond its window (the player would draw them in the wrong place)
+static int64_t Bench_Decode(VidDecoder* dec, uint8_t type, const VidInfo* info, VidRef* ref,
+                            const uint8_t* payload, uint32_t len) {
+    static uint8_t in_buf[VID_CODEC_MAX_TOKEN + BENCH_IN_SIZE];
+    static uint8_t band[BENCH_BAND_SIZE] __attribute__((aligned(4)));
+    uint32_t in_pos = 0, in_len = 0, read = 0, out_len = 0;
+    int64_t total = 0;
+
+    if(!VidDecoder_Begin(dec, type, info, ref))
+        return -1;
+
+    // bytes left in the current window: the whole frame until a rect decoder opens one
+    uint32_t window_left = dec->out_remaining;
+
+    while(dec->out_remaining > 0) {
+        VidCodec_In in = { &in_buf[in_pos], &in_buf[in_len] };
+        int32_t produced = VidDecoder_Run(dec, &in, &band[out_len], BENCH_BAND_SIZE - out_len);
+        if(produced < 0)
+            return -1;
+
+        in_pos = in.ptr - in_buf;
+        total += produced;
+
+        if(dec->rect_new) {
+            dec->rect_new = false;
+            if(out_len != 0)
+                return -2;
+            window_left = Vid_PixelBytes(info, (uint32_t) dec->rect.w * dec->rect.h);
+        }
+        out_len += produced;
+
+        // the band is submitted as in SDPlayback_DecodeBand
+        if(out_len == BENCH_BAND_SIZE || dec->out_remaining == 0 || dec->band_break) {
+            if(out_len > window_left)
+                return -2;
+            window_left -= out_len;
+            out_len = 0;
+            continue;
+        }
+        if(produced > 0)
+            continue;
+
+        // short of input: keep the leftover and read the next chunk
+        uint32_t keep = in_len - in_pos;
+        uint32_t n = (len - read < BENCH_IN_SIZE) ? len - read : BENCH_IN_SIZE;
+        if(n == 0 || keep > VID_CODEC_MAX_TOKEN)
+            return -1;
+
+        memmove(in_buf, &in_buf[in_pos], keep);
+        memcpy(&in_buf[keep], &payload[read], n);
+        read += n;
+        in_pos = 0;
+        in_len = keep + n;
+    }
+
+    return total;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s video.bin [sd_read_MBps]\n", argv[0]);
+        return 1;
+    }
+    double sd_mbps = (argc > 2) ? atof(argv[2]) : BENCH_SD_MBPS;
+
+    FILE* f = fopen(argv[1], "rb");
+    if(f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* file = malloc(size);
+    if(file == NULL || fread(file, 1, size, f) != (size_t) size) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+    fclose(f);
+
+    if(size < VID_HEADER_LEN || memcmp(file, VID_MAGIC, VID_MAGIC_LEN) != 0 || file[VID_HDR_VERSION] < 2) {
+        fprintf(stderr, "not a v2 video binary\n");
+        return 1;
+    }
+
+    VidInfo info = {
+        .version = file[VID_HDR_VERSION],
+        .width = Vid_ReadU16(&file[VID_HDR_WIDTH]),
+        .height = Vid_ReadU16(&file[VID_HDR_HEIGHT]),
+        .num_frames = Vid_ReadU32(&file[VID_HDR_NUM_FRAMES]),
+        .flags = Vid_ReadU16(&file[VID_HDR_FLAGS]),
+        .index_offset = Vid_ReadU32(&file[VID_HDR_INDEX_OFFSET]),
+        .table_offset = Vid_ReadU32(&file[VID_HDR_TABLE_OFFSET]),
+    };
+    bool aligned = (info.flags & VID_FLAG_ALIGNED) != 0;
+    if(info.index_offset == 0) {
+        fprintf(stderr, "video binary has no frame index\n");
+        return 1;
+    }
+
+    // reference frame for motion frames
+    VidRef ref = { .size = (uint32_t) info.width * VID_REF_LINES(info.height) * 2 };
+    ref.pixels = calloc(1, ref.size);
+    VidRef_Reset(&ref, info.width, info.height);
+
+    // entropy coded frames: lookup table and a buffer for the decoded payload
+    static uint16_t huff_lookup[1 << VID_HUFF_MAX_BITS];
+    bool entropy = (info.flags & VID_FLAG_ENTROPY) != 0;
+    if(entropy && (info.table_offset == 0 || info.table_offset + VID_HUFF_TABLE_LEN > (uint64_t) size ||
+                   !VidHuff_Build(huff_lookup, &file[info.table_offset]))) {
+        fprintf(stderr, "invalid entropy code table\n");
+        return 1;
+    }
+    uint32_t plain_cap = (uint32_t) info.width * info.height * 4 + 1024;
+    uint8_t* plain = malloc(plain_cap);
+
+    static VidDecoder dec;
+    BenchType types[VidFrame_COUNT] = { 0 };
+    BenchType entropy_bench = { 0 };
+    double start = Bench_Now();
+    uint32_t passes = 0;
+
+    // whole file passes until the timings are long enough
+    do {
+        for(uint32_t i = 0; i < info.num_frames; i++) {
+            const uint8_t* entry = &file[info.index_offset + i * (aligned ? VID_ALIGNED_INDEX_ENTRY_LEN : VID_INDEX_ENTRY_LEN)];
+            uint32_t offset = Vid_ReadU32(entry) & VID_INDEX_OFFSET_MASK;
+            uint8_t type;
+            uint32_t len;
+
+            if(aligned) {
+                uint32_t desc = Vid_ReadU32(&entry[4]);
+                type = VID_DESC_TYPE(desc);
+                len = VID_DESC_LEN(desc);
+            } else {
+                type = file[offset + VID_FRAME_FLAG_LEN];
+                len = Vid_ReadU32(&file[offset + VID_FRAME_FLAG_LEN + 1]);
+                offset += VID_FRAME_HEADER_LEN;
+            }
+
+            bool coded = (type & VID_FRAME_ENTROPY) != 0;
+            type &= ~VID_FRAME_ENTROPY;
+            if(type == VidFrame_RAW || type >= VidFrame_COUNT || (uint64_t) offset + len > (uint64_t) size ||
+               (coded && !entropy))
+                continue;
+
+            double t = Bench_Now();
+            const uint8_t* payload = &file[offset];
+            int64_t payload_len = len;
+            if(coded) {
+                payload_len = Bench_Entropy(huff_lookup, payload, len, plain, plain_cap);
+                payload = plain;
+
+                double entropy_seconds = Bench_Now() - t;
+                entropy_bench.seconds += entropy_seconds;
+                types[type].seconds += entropy_seconds;
+                t = Bench_Now();
+                if(payload_len < 0) {
+                    fprintf(stderr, "frame %u (type %d) failed to entropy decode\n", i, type);
+                    return 1;
+                }
+                if(passes == 0) {
+                    entropy_bench.frames++;
+                    entropy_bench.payload_bytes += len;
+                    entropy_bench.pixel_bytes += payload_len;
+                }
+            }
+
+            int64_t pixels = Bench_Decode(&dec, type, &info, &ref, payload, payload_len);
+            types[type].seconds += Bench_Now() - t;
+            if(pixels < 0) {
+                fprintf(stderr, "frame %u (type %d) %s\n", i, type,
+                        (pixels == -2) ? "band overruns its window" : "failed to decode");
+                return 1;
+            }
+
+            if(passes == 0) {
+                types[type].frames++;
+                types[type].payload_bytes += len;
+                types[type].pixel_bytes += pixels;
+            }
+        }
+        passes++;
+    } while(Bench_Now() - start < BENCH_MIN_SECONDS);
+
+    printf("%s: %ux%u, %u frames, %u passes, SD read %.2f MB/s\n", argv[1], info.width, info.height,
+           info.num_frames, passes, sd_mbps);
+    printf("type  frames  payload KB  pixels KB  ratio  host MB/s  needs MB/s\n");
+    for(int t = 0; t < VidFrame_COUNT; t++) {
+        BenchType* b = &types[t];
+        if(b->frames == 0)
+            continue;
+
+        double host_mbps = b->pixel_bytes * (double) passes / b->seconds / 1e6;
+        printf("%4d  %6u  %10.1f  %9.1f  %5.2f  %9.1f  ", t, b->frames, b->payload_bytes / 1024.0,
+               b->pixel_bytes / 1024.0, (double) b->payload_bytes / b->pixel_bytes, host_mbps);
+        if(b->payload_bytes < b->pixel_bytes)
+            printf("%10.2f\n", sd_mbps * b->pixel_bytes / (b->pixel_bytes - b->payload_bytes));
+        else
+            printf("%10s\n", "never");
+    }
+
+    if(entropy_bench.frames > 0) {
+        double frame_us = entropy_bench.seconds / passes / entropy_bench.frames * 1e6;
+        printf("entropy: %u frames, %.1f KB -> %.1f KB (%.2f), host %.1f MB/s, %.1f us/frame\n",
+               entropy_bench.frames, entropy_bench.payload_bytes / 1024.0, entropy_bench.pixel_bytes / 1024.0,
+               (double) entropy_bench.payload_bytes / entropy_bench.pixel_bytes,
+               entropy_bench.pixel_bytes * (double) passes / entropy_bench.seconds / 1e6, frame_us);
+    }
+
+    free(plain);
+    free(ref.pixels);
+    free(file);
+    return 0;
+}
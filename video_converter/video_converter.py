@@ -2,9 +2,12 @@ import re
 import os
 import glob
 import cv2
+import numpy as np
 from concurrent.futures import ProcessPoolExecutor
 import argparse
-from dataclasses import dataclass
+import heapq
+import struct
+from dataclasses import dataclass, field
 
 def extract_resolution(c_file_path):
     with open(c_file_path, 'r') as f:
@@ -44,61 +47,1186 @@ def extract_c_to_binary(c_file_path):
 
     return bin_data
 
-def lvgl_convert_to_c_single(i, dir):
-    os.system(f"python lvgl-convert.py --ofmt C --cf RGB565_SWAPPED {dir}/{i}.png")
+def lvgl_convert_to_c_single(i, dir, cf):
+    os.system(f"python lvgl-convert.py --ofmt C --cf {cf} {dir}/{i}.png")
     print(f"Generated: {i}.c")
 
 # n frames: 1.png, 2.png ... n.png
-def lvgl_convert_to_c(n, dir):
+# cf: LVGL color format, RGB565_SWAPPED, I8, I4 or I1 (palette quantized with pngquant), or RGB888
+def lvgl_convert_to_c(n, dir, cf="RGB565_SWAPPED"):
     with ProcessPoolExecutor() as executor:
-        futures = [executor.submit(lvgl_convert_to_c_single, i, dir) for i in range(1, n + 1)]
+        futures = [executor.submit(lvgl_convert_to_c_single, i, dir, cf) for i in range(1, n + 1)]
         for f in futures:
             f.result()  # wait for all to finish
 
-# Format [width upper][width lower][height upper][height lower][num_frames upper][num_frames lower]
-# [START flag 'FRM'][data ...][START flag 'FRM'][data ...] ...
+# Format v2 (big-endian), see "Video Format" in README.md
+# Header (32 bytes):
 # ---------------------------
+# magic         - 3 bytes (fixed value 'VID')
+# version       - 1 byte  (2)
 # width         - 2 bytes
 # height        - 2 bytes
-# num_frames    - 2 bytes
+# num_frames    - 4 bytes
+# fps_x100      - 2 bytes (frames per second * 100)
+# flags         - 2 bytes (VID_FLAG_ALIGNED, VID_FLAG_MOTION, VID_FLAG_RGB444, VID_FLAG_ENTROPY)
+# data_offset   - 4 bytes (offset of the first frame record)
+# index_offset  - 4 bytes (offset of the frame index, 0 = none)
+# table_offset  - 4 bytes (offset of the entropy code table, 0 = none)
+# reserved      - 4 bytes
+# ---------------------------
+# Entropy code table (flags & VID_FLAG_ENTROPY, right after the header):
+# code lengths  - 128 bytes (see huff_table)
+# ---------------------------
+# Frame index (at index_offset, after the header and code table):
+# offset        - 4 bytes per frame (offset of the frame record)
+# ---------------------------
+# Per frame:
 # START frame   - 3 bytes (fixed value 'FRM')
+# frame type    - 1 byte  (FRAME_RAW)
+# payload len   - 4 bytes
+# payload       - payload len bytes
 # ---------------------------
-def c_to_vid_bin(n, input_dir, out_dir):
-    out_fname = out_dir + "/video.bin"
+# Sector-aligned layout (flags & VID_FLAG_ALIGNED):
+# header padded to 512 bytes, index at 512 with 8-byte entries:
+# offset        - 4 bytes (offset of the frame payload, a multiple of 512)
+# descriptor    - 4 bytes (frame type << 24 | payload len)
+# Frame types:
+# FRAME_RAW     - RGB565 pixels
+# FRAME_RLE     - LVGL RLE stream of RGB565 pixels (see rle_encode)
+# FRAME_DELTA   - changed rectangles since the previous frame (see delta_payload)
+# FRAME_MOTION  - 8x8 blocks skipped, copied from the previous frame or raw (see motion_payload)
+# FRAME_I8      - RGB565 palette, then one palette index per pixel (see palette_payload)
+# FRAME_I4      - up to 16 color palette, then two pixels per byte (see palette_payload)
+# FRAME_MONO    - two colors, then one bit per pixel or run lengths (see mono_payload)
+# FRAME_YUV420  - YCbCr, chroma shared by 2x2 pixels (see yuv420_payload)
+# FRAME_BTC     - two colors and a mask per 4x4 block (see btc_payload)
+# FRAME_VQ      - codebook of 2x2 patches, one index per block (see vq_payload)
+# FRAME_LZ      - LZ4-style literals and matches over the pixel bytes (see lz_encode)
+# FRAME_JPEG    - baseline JPEG image of the frame (see jpeg_payload)
+# frame type | FRAME_ENTROPY - payload of that frame type, Huffman coded (see huff_encode)
+# ---------------------------
+# Frame payloads have no 'FRM' header and are zero-padded to a multiple of 512 bytes,
+# so the player reads whole sectors straight into its buffers.
+# ---------------------------
+VID_MAGIC = b"VID"
+VID_VERSION = 2
+VID_HEADER_LEN = 32
+FRAME_START_FLAG = b"FRM"
+FRAME_RAW = 0
+FRAME_RLE = 1
+FRAME_DELTA = 2
+FRAME_MOTION = 3
+FRAME_I8 = 4
+FRAME_I4 = 5
+FRAME_MONO = 6
+FRAME_YUV420 = 7
+FRAME_BTC = 8
+FRAME_VQ = 9
+FRAME_LZ = 10
+FRAME_JPEG = 11
+FRAME_ENTROPY = 0x80            # frame type flag: payload is entropy coded
+
+VID_INDEX_ENTRY_LEN = 4
+VID_INDEX_DELTA = 0x80000000    # index entry flag: frame depends on the previous frame
+
+VID_FLAG_ALIGNED = 0x0001
+VID_FLAG_MOTION = 0x0002        # file has motion frames: the player keeps a reference frame
+VID_FLAG_RGB444 = 0x0004        # pixels are packed RGB444, see rgb444_pack
+VID_FLAG_ENTROPY = 0x0008       # file has entropy coded frames and a code table
+VID_SECTOR_SIZE = 512
+VID_ALIGNED_INDEX_ENTRY_LEN = 8
+
+def vid_header(width, height, num_frames, fps, flags=0, data_offset=VID_HEADER_LEN, index_offset=0, table_offset=0):
+    fps_x100 = int(round(fps * 100))
+    if width > 0xFFFF or height > 0xFFFF or fps_x100 > 0xFFFF:
+        raise ValueError("Header field exceeds its range.")
+
+    return struct.pack(">3sBHHIHHIII4x", VID_MAGIC, VID_VERSION, width, height, num_frames,
+                       fps_x100, flags, data_offset, index_offset, table_offset)
+
+def index_flags(frame_type):
+    return VID_INDEX_DELTA if frame_type & ~FRAME_ENTROPY in (FRAME_DELTA, FRAME_MOTION) else 0
+
+def header_flags(frames):
+    return VID_FLAG_MOTION if any(frame_type & ~FRAME_ENTROPY == FRAME_MOTION for frame_type, _ in frames) else 0
+
+def align_up(n, align=VID_SECTOR_SIZE):
+    return (n + align - 1) // align * align
+
+# Header, frame index and frame records of a complete video binary.
+# frames: list of (frame type, payload); flags: VID_FLAG_* besides the layout, motion and entropy flags
+# table: entropy code table of the frames (huff_table), None without entropy coded frames
+def vid_bin(width, height, fps, frames, aligned=True, flags=0, table=None):
+    if aligned:
+        return vid_bin_aligned(width, height, fps, frames, flags, table)
+
+    records = [frame_record(frame_type, payload) for frame_type, payload in frames]
+
+    table = table or b""
+    table_offset = VID_HEADER_LEN if table else 0
+    if table:
+        flags |= VID_FLAG_ENTROPY
+    index_offset = VID_HEADER_LEN + len(table)
+    data_offset = index_offset + len(records) * VID_INDEX_ENTRY_LEN
+
+    index = bytearray()
+    offset = data_offset
+    for (frame_type, _), record in zip(frames, records):
+        if offset > 0x7FFFFFFF:
+            raise ValueError("Video binary exceeds 2GB.")
+        index.extend(struct.pack(">I", offset | index_flags(frame_type)))
+        offset += len(record)
+
+    bin_data = bytearray()
+    bin_data.extend(vid_header(width, height, len(records), fps, flags=flags | header_flags(frames),
+                               data_offset=data_offset, index_offset=index_offset, table_offset=table_offset))
+    bin_data.extend(table)
+    bin_data.extend(index)
+    for record in records:
+        bin_data.extend(record)
+
+    return bin_data
+
+# the code table is kept in the header sector
+def vid_bin_aligned(width, height, fps, frames, flags=0, table=None):
+    table = table or b""
+    table_offset = VID_HEADER_LEN if table else 0
+    if table:
+        flags |= VID_FLAG_ENTROPY
+    index_offset = VID_SECTOR_SIZE
+    data_offset = align_up(index_offset + len(frames) * VID_ALIGNED_INDEX_ENTRY_LEN)
+
+    index = bytearray()
+    offset = data_offset
+    for frame_type, payload in frames:
+        if offset > 0x7FFFFFFF:
+            raise ValueError("Video binary exceeds 2GB.")
+        if len(payload) > 0xFFFFFF:
+            raise ValueError("Frame payload exceeds 16MB.")
+        index.extend(struct.pack(">II", offset | index_flags(frame_type), (frame_type << 24) | len(payload)))
+        offset += align_up(len(payload))
+
+    bin_data = bytearray()
+    bin_data.extend(vid_header(width, height, len(frames), fps, flags=flags | VID_FLAG_ALIGNED | header_flags(frames),
+                               data_offset=data_offset, index_offset=index_offset, table_offset=table_offset))
+    bin_data.extend(table)
+    bin_data.extend(bytes(index_offset - len(bin_data)))
+    bin_data.extend(index)
+    bin_data.extend(bytes(data_offset - len(bin_data)))
+    for frame_type, payload in frames:
+        bin_data.extend(payload)
+        bin_data.extend(bytes(align_up(len(payload)) - len(payload)))
+
+    return bin_data
+
+# RLE with the stream format of RLEImage.rle_compress in lvgl-convert.py, 2-byte blocks:
+# ctrl byte with bit 7 set -> (ctrl & 0x7F) literal pixels follow,
+# otherwise -> one pixel follows, repeated ctrl times.
+# Repeats shorter than min_run pixels are kept in literal runs (a repeat costs 3 bytes).
+RLE_MAX_COUNT = 127
+RLE_MIN_RUN = 3
+
+def rle_encode(data, blksize=2, min_run=RLE_MIN_RUN):
+    n = len(data) // blksize
+    pixels = [bytes(data[i * blksize:(i + 1) * blksize]) for i in range(n)]
+    out = bytearray()
+
+    def flush_literal(start, end):
+        while start < end:
+            count = min(RLE_MAX_COUNT, end - start)
+            out.append(0x80 | count)
+            out.extend(data[start * blksize:(start + count) * blksize])
+            start += count
+
+    literal_start = 0
+    i = 0
+    while i < n:
+        run = 1
+        while i + run < n and run < RLE_MAX_COUNT and pixels[i + run] == pixels[i]:
+            run += 1
+
+        if run >= min_run:
+            flush_literal(literal_start, i)
+            out.append(run)
+            out.extend(pixels[i])
+            literal_start = i + run
+        i += run
+
+    flush_literal(literal_start, n)
+    return bytes(out)
+
+# LZ4-style coding for lossless frames RLE handles poorly (dithering, textures). Sequences of
+# [token: literal_len << 4 | (match_len - 4)][literal_len - 15 in 255 steps if the nibble is 15]
+# [literals][offset (u16)][match_len - 19 in 255 steps if the nibble is 15]; the frame ends after its
+# last literals. The player keeps only the last LZ_WINDOW bytes, so offsets are limited to it.
+# Greedy matching with one candidate per 4-byte hash, as in LZ4.
+LZ_WINDOW = 2048
+LZ_MIN_MATCH = 4
+
+def lz_length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+def lz_sequence(out, literals, offset=0, match_len=LZ_MIN_MATCH):
+    lit_len, match_code = len(literals), match_len - LZ_MIN_MATCH
+    out.append(min(lit_len, 15) << 4 | min(match_code, 15))
+    if lit_len >= 15:
+        lz_length(out, lit_len - 15)
+    out.extend(literals)
+
+    if offset:
+        out.extend(struct.pack(">H", offset))
+        if match_code >= 15:
+            lz_length(out, match_code - 15)
+
+def lz_encode(data):
+    data = bytes(data)
+    n = len(data)
+    out = bytearray()
+    table = {}
+    lit_start = 0
+    i = 0
+    while i + LZ_MIN_MATCH <= n:
+        key = data[i:i + LZ_MIN_MATCH]
+        cand = table.get(key)
+        table[key] = i
+        if cand is None or i - cand > LZ_WINDOW:
+            i += 1
+            continue
+
+        match_len = LZ_MIN_MATCH
+        while i + match_len < n and data[cand + match_len] == data[i + match_len]:
+            match_len += 1
+
+        lz_sequence(out, data[lit_start:i], i - cand, match_len)
+        i += match_len
+        lit_start = i
+        # keep the table fresh at the end of the match
+        if i - 2 + LZ_MIN_MATCH <= n:
+            table[data[i - 2:i - 2 + LZ_MIN_MATCH]] = i - 2
+
+    if lit_start < n:
+        lz_sequence(out, data[lit_start:])
+    return bytes(out)
+
+# Entropy coding: one canonical Huffman code per video over the bytes of all coded payloads, applied
+# to the payloads it makes smaller. The player decodes codes with a single lookup in a table of
+# 2^HUFF_MAX_BITS entries, so code lengths are limited to HUFF_MAX_BITS (counts are halved until
+# the code fits). Coded payload: [payload len (u32)][codes, MSB first, zero bits to a whole byte]
+# [HUFF_PAD zero bytes, so the player can always look HUFF_MAX_BITS ahead].
+HUFF_MAX_BITS = 10
+HUFF_PAD = 2
+
+def huff_lengths(counts, max_bits=HUFF_MAX_BITS):
+    counts = [int(c) for c in counts]
+    while True:
+        lengths = [0] * 256
+        heap = [(c, sym, [sym]) for sym, c in enumerate(counts) if c > 0]
+        if len(heap) == 1:
+            lengths[heap[0][1]] = 1
+            return lengths
+
+        # merged groups are keyed by their smallest value, which is unique
+        heapq.heapify(heap)
+        while len(heap) > 1:
+            c1, k1, s1 = heapq.heappop(heap)
+            c2, k2, s2 = heapq.heappop(heap)
+            for sym in s1 + s2:
+                lengths[sym] += 1
+            heapq.heappush(heap, (c1 + c2, min(k1, k2), s1 + s2))
+
+        if max(lengths) <= max_bits:
+            return lengths
+        counts = [(c + 1) // 2 for c in counts]
+
+# code lengths of the 256 byte values, two per byte, high nibble first
+def huff_table(lengths):
+    return bytes(lengths[i] << 4 | lengths[i + 1] for i in range(0, 256, 2))
+
+# canonical codes as bit strings: shorter codes first, then by value
+def huff_codes(lengths):
+    codes = {}
+    code, prev_len = 0, 0
+    for length, sym in sorted((length, sym) for sym, length in enumerate(lengths) if length):
+        code <<= length - prev_len
+        codes[sym] = format(code, f"0{length}b")
+        code += 1
+        prev_len = length
+    return codes
+
+def huff_encode(payload, codes):
+    bits = "".join(codes[b] for b in payload)
+    bits += "0" * (-len(bits) % 8)
+    packed = np.packbits(np.frombuffer(bits.encode(), dtype=np.uint8) - ord("0")).tobytes()
+    return struct.pack(">I", len(payload)) + packed + bytes(HUFF_PAD)
+
+# (frames, table): frames with the payloads the video's code makes smaller entropy coded, and the
+# code table (None when no frame is coded). Raw and JPEG frames (already entropy coded) are left as
+# they are. With a device profile, a payload is coded when that shortens its predicted frame time.
+def entropy_code(frames, profile=None, width=0, height=0, rgb444=False):
+    counts = np.zeros(256, dtype=np.int64)
+    for frame_type, payload in frames:
+        if frame_type not in (FRAME_RAW, FRAME_JPEG):
+            counts += np.bincount(np.frombuffer(payload, dtype=np.uint8), minlength=256)
+    if not counts.any():
+        return frames, None
+
+    lengths = huff_lengths(counts)
+    codes = huff_codes(lengths)
+    coded_frames = []
+    for frame_type, payload in frames:
+        if frame_type not in (FRAME_RAW, FRAME_JPEG):
+            coded = huff_encode(payload, codes)
+            if profile is not None:
+                pays = (frame_time(profile, frame_type, payload, width, height, rgb444, len(coded)) <
+                        frame_time(profile, frame_type, payload, width, height, rgb444))
+            else:
+                pays = len(coded) < len(payload)
+            if pays:
+                frame_type, payload = frame_type | FRAME_ENTROPY, coded
+        coded_frames.append((frame_type, payload))
+
+    if not any(frame_type & FRAME_ENTROPY for frame_type, _ in coded_frames):
+        return frames, None
+    return coded_frames, huff_table(lengths)
+
+# Delta frames: the frame is compared with the previous one on a DELTA_TILE grid. Changed tiles
+# are merged into rectangles (runs of tiles along a row, then runs with the same columns down
+# consecutive rows), and each rectangle is sent with its own display window.
+DELTA_TILE = 8
+DELTA_RECT_COST = 24    # bytes of SD + SPI traffic a rectangle costs beyond its pixels (header, window commands)
+
+def delta_rects(prev, cur, width, height, tile=DELTA_TILE):
+    a = np.frombuffer(prev, dtype=">u2").reshape(height, width)
+    b = np.frombuffer(cur, dtype=">u2").reshape(height, width)
+    tiles_y, tiles_x = -(-height // tile), -(-width // tile)
+
+    changed = np.zeros((tiles_y * tile, tiles_x * tile), dtype=bool)
+    changed[:height, :width] = a != b
+    tile_changed = changed.reshape(tiles_y, tile, tiles_x, tile).any(axis=(1, 3))
+
+    rects = []
+    open_runs = {}  # (tx0, tx1) -> [ty0, ty1]
+    for ty in range(tiles_y + 1):
+        runs = set()
+        if ty < tiles_y:
+            tx = 0
+            while tx < tiles_x:
+                if tile_changed[ty, tx]:
+                    tx0 = tx
+                    while tx < tiles_x and tile_changed[ty, tx]:
+                        tx += 1
+                    runs.add((tx0, tx))
+                tx += 1
+
+        for run in list(open_runs):
+            if run in runs:
+                open_runs[run][1] = ty + 1
+                runs.discard(run)
+            else:
+                ty0, ty1 = open_runs.pop(run)
+                rects.append((run[0], ty0, run[1], ty1))
+        for run in runs:
+            open_runs[run] = [ty, ty + 1]
+
+    # tile units -> pixels, clipped to the frame
+    return [(tx0 * tile, ty0 * tile, min(tx1 * tile, width) - tx0 * tile, min(ty1 * tile, height) - ty0 * tile)
+            for tx0, ty0, tx1, ty1 in sorted(rects, key=lambda r: (r[1], r[0]))]
+
+def delta_payload(cur, width, rects, rgb444=False):
+    pixels = bytearray()
+    pixel_bytes = 0
+    for x, y, w, h in rects:
+        pixels.extend(struct.pack(">HHHH", x, y, w, h))
+        rect = b"".join(cur[(row * width + x) * 2:(row * width + x + w) * 2] for row in range(y, y + h))
+        if rgb444:
+            rect = rgb444_pack(rect)
+        pixels.extend(rect)
+        pixel_bytes += len(rect)
+
+    return struct.pack(">HI", len(rects), pixel_bytes) + bytes(pixels)
+
+# RGB444 files: the display runs in 12-bit mode (COLMOD 0x03) and frames are stored as it takes
+# them, two pixels in three bytes [R1 G1][B1 R2][G2 B2], so SD and SPI bytes both drop by a quarter
+# with no work on the player. Frames are RGB565 until written; rgb444_quantize() keeps the top 4 bits
+# of each channel so delta frames compare what the panel shows. The width must be even.
+RGB444_MASK = 0xF79E    # top 4 bits of R5, G6 and B5
+
+def rgb444_quantize(data):
+    return (np.frombuffer(bytes(data), dtype=">u2") & RGB444_MASK).astype(">u2").tobytes()
+
+def rgb444_pack(data):
+    v = np.frombuffer(bytes(data), dtype=">u2").reshape(-1, 2)
+    r, g, b = v >> 12, (v >> 7) & 0xF, (v >> 1) & 0xF
+    packed = np.column_stack([r[:, 0] << 4 | g[:, 0], b[:, 0] << 4 | r[:, 1], g[:, 1] << 4 | b[:, 1]])
+    return packed.astype(np.uint8).tobytes()
+
+# Indexed frames: LVGL's I8 / I4 / I1 conversion quantizes each frame to a 256 / 16 / 2 color
+# palette (pngquant). Its C array holds the palette as (B, G, R, A) entries, then the indices,
+# packed high bits first with each row padded to a whole byte.
+# Frames with at most MONO_MAX_COLORS colors are written as mono frames, with at most
+# I4_MAX_COLORS as I4 frames and the others as I8 frames.
+COLOR_BPP = {"i8": 8, "i4": 4, "mono": 1}
+I4_MAX_COLORS = 16
+MONO_MAX_COLORS = 2
+
+# (RGB565 palette, one index per pixel) of an LVGL indexed image; the palette is cut after the
+# last used color
+def indexed_from_lvgl(data, width, height, bpp=8):
+    palette_len = 1 << bpp
+    stride = (width * bpp + 7) // 8
+    bgra = np.frombuffer(bytes(data[:palette_len * 4]), dtype=np.uint8).reshape(-1, 4).astype(np.uint16)
+    packed = np.frombuffer(bytes(data[palette_len * 4:]), dtype=np.uint8)[:stride * height]
+    if len(packed) != stride * height:
+        raise ValueError("Indexed image data is too short.")
+
+    shifts = np.arange(8 - bpp, -1, -bpp, dtype=np.uint8)
+    rows = (packed.reshape(height, stride, 1) >> shifts) & (palette_len - 1)
+    indices = np.ascontiguousarray(rows.reshape(height, -1)[:, :width]).reshape(-1)
+
+    palette = (bgra[:, 2] >> 3) << 11 | (bgra[:, 1] >> 2) << 5 | bgra[:, 0] >> 3
+    return palette[:int(indices.max()) + 1], indices
+
+def palette_expand(palette, indices):
+    return palette.astype(">u2")[indices].tobytes()
+
+def palette_frame_type(palette):
+    if len(palette) <= MONO_MAX_COLORS:
+        return FRAME_MONO
+    return FRAME_I4 if len(palette) <= I4_MAX_COLORS else FRAME_I8
+
+def palette_payload(palette, indices):
+    if palette_frame_type(palette) == FRAME_MONO:
+        return mono_payload(palette, indices)
+
+    header = struct.pack(">H", len(palette)) + palette.astype(">u2").tobytes()
+    if palette_frame_type(palette) == FRAME_I8:
+        return header + indices.tobytes()
+
+    if len(indices) % 2:
+        indices = np.append(indices, 0)
+    return header + (indices[0::2] << 4 | indices[1::2]).astype(np.uint8).tobytes()
+
+# Mono frames: palette entry 1 is drawn as fg, entry 0 as bg. The bits are run-length coded
+# (alternating bg / fg runs, LEB128 lengths) when that is smaller.
+MONO_BITS = 0
+MONO_RUNS = 1
+MONO_MAX_RUN = (1 << 21) - 1     # 3 varint bytes
+
+def mono_runs(indices):
+    bits = np.asarray(indices, dtype=np.int8)
+    edges = np.flatnonzero(np.diff(bits)) + 1
+    bounds = np.concatenate(([0], edges, [len(bits)]))
+    lengths = list(np.diff(bounds))
+    if bits[0] == 1:
+        lengths.insert(0, 0)  # runs start with bg
+
+    out = bytearray()
+    for length in lengths:
+        length = int(length)
+        while length > MONO_MAX_RUN:
+            out.extend(varint(MONO_MAX_RUN) + varint(0))  # zero-length run of the other color
+            length -= MONO_MAX_RUN
+        out.extend(varint(length))
+    return bytes(out)
+
+def varint(n):
+    out = bytearray()
+    while True:
+        if n < 0x80:
+            out.append(n)
+            return bytes(out)
+        out.append(0x80 | n & 0x7F)
+        n >>= 7
+
+def mono_payload(palette, indices):
+    fg = int(palette[1]) if len(palette) > 1 else int(palette[0])
+    header = struct.pack(">HH", fg, int(palette[0]))
+
+    bits = np.packbits(np.asarray(indices, dtype=np.uint8)).tobytes()
+    runs = mono_runs(indices)
+    if len(runs) < len(bits):
+        return header + bytes([MONO_RUNS]) + runs
+    return header + bytes([MONO_BITS]) + bits
+
+# Replace the two colors of a mono palette, the brighter one with fg (RGB888 values)
+def mono_recolor(palette, fg, bg):
+    def rgb565(c):
+        return (c >> 19 & 0x1F) << 11 | (c >> 10 & 0x3F) << 5 | (c >> 3 & 0x1F)
+
+    def luma(c):
+        return (c >> 11) * 2 + (c >> 5 & 0x3F) + (c & 0x1F) * 2
+
+    colors = np.array([rgb565(bg), rgb565(fg)], dtype=np.uint16)
+    if len(palette) == 1:
+        return colors[:1]
+    if luma(int(palette[0])) > luma(int(palette[1])):
+        colors = colors[::-1]
+    return colors
+
+# YUV 4:2:0 frames, converted from LVGL RGB888 (B, G, R bytes per pixel). Full range BT.601 as in
+# JPEG; U and V are averaged over each 2x2 block. Even lines are [Y0][Y1][U][V] per pixel pair,
+# odd lines [Y0][Y1] reusing the chroma of the line above.
+# yuv420_expand() repeats the player's fixed point conversion, so the expected frame is exact.
+YUV_RV, YUV_GU, YUV_GV, YUV_BU = 22970, -5638, -11700, 29032   # 2.14 fixed point
+YUV_SHIFT = 14
+
+def rgb888_from_lvgl(data, width, height):
+    bgr = np.frombuffer(bytes(data[:width * height * 3]), dtype=np.uint8).reshape(height, width, 3)
+    return bgr[:, :, ::-1].astype(np.float32)
+
+def yuv420_payload(rgb):
+    height, width, _ = rgb.shape
+    if width % 2:
+        raise ValueError("YUV420 frames need an even width.")
+
+    r, g, b = rgb[:, :, 0], rgb[:, :, 1], rgb[:, :, 2]
+    y = 0.299 * r + 0.587 * g + 0.114 * b
+    u = -0.168736 * r - 0.331264 * g + 0.5 * b + 128
+    v = 0.5 * r - 0.418688 * g - 0.081312 * b + 128
+
+    def chroma(c):
+        c = np.vstack([c, c[-1:]]) if height % 2 else c  # odd height: last line averages with itself
+        return c.reshape(-1, 2, width // 2, 2).mean(axis=(1, 3))
+
+    def to_u8(c):
+        return np.clip(np.rint(c), 0, 255).astype(np.uint8)
+
+    y, u, v = to_u8(y), to_u8(chroma(u)), to_u8(chroma(v))
+    out = bytearray()
+    for line in range(height):
+        pairs = y[line].reshape(-1, 2)
+        if line % 2 == 0:
+            pairs = np.column_stack([pairs, u[line // 2], v[line // 2]])
+        out.extend(pairs.tobytes())
+    return bytes(out)
+
+def yuv420_expand(payload, width, height):
+    data = np.frombuffer(payload, dtype=np.uint8)
+    rows = []
+    pos = 0
+    for line in range(height):
+        if line % 2 == 0:
+            group = data[pos:pos + width * 2].reshape(-1, 4).astype(np.int32)
+            pos += width * 2
+            u, v = group[:, 2] - 128, group[:, 3] - 128
+            y = group[:, :2]
+        else:
+            y = data[pos:pos + width].reshape(-1, 2).astype(np.int32)
+            pos += width
+
+        round_ = 1 << (YUV_SHIFT - 1)
+        dr = ((YUV_RV * v + round_) >> YUV_SHIFT)[:, None]
+        dg = ((YUV_GU * u + YUV_GV * v + round_) >> YUV_SHIFT)[:, None]
+        db = ((YUV_BU * u + round_) >> YUV_SHIFT)[:, None]
+        r, g, b = (np.clip(y + d, 0, 255) for d in (dr, dg, db))
+        rows.append(((r & 0xF8) << 8 | (g & 0xFC) << 3 | b >> 3).reshape(-1))
+    return np.concatenate(rows).astype(">u2").tobytes()
+
+# JPEG frames: baseline JPEG of the RGB888 frame, as OpenCV writes it (4:2:0, optimized Huffman
+# tables), without its APPn and COM segments. The player decodes it in MCU tiles with box filtered
+# chroma, so the frame on screen can differ from jpeg_expand() by a few levels around color edges.
+JPEG_APP0, JPEG_APP15, JPEG_COM, JPEG_SOS = 0xE0, 0xEF, 0xFE, 0xDA
+
+def jpeg_payload(rgb, quality=75):
+    bgr = np.ascontiguousarray(np.clip(np.rint(rgb[:, :, ::-1]), 0, 255).astype(np.uint8))
+    ok, data = cv2.imencode(".jpg", bgr, [cv2.IMWRITE_JPEG_QUALITY, quality, cv2.IMWRITE_JPEG_OPTIMIZE, 1])
+    if not ok:
+        raise ValueError("JPEG encoding failed.")
+
+    data = data.tobytes()
+    out = bytearray(data[:2])   # SOI
+    pos = 2
+    while True:
+        marker = data[pos + 1]
+        if marker == JPEG_SOS:
+            out += data[pos:]   # scan and EOI
+            return bytes(out)
+        seg_len = 2 + struct.unpack(">H", data[pos + 2:pos + 4])[0]
+        if not (JPEG_APP0 <= marker <= JPEG_APP15 or marker == JPEG_COM):
+            out += data[pos:pos + seg_len]
+        pos += seg_len
+
+def jpeg_expand(payload):
+    bgr = cv2.imdecode(np.frombuffer(payload, dtype=np.uint8), cv2.IMREAD_COLOR).astype(np.uint32)
+    b, g, r = bgr[:, :, 0], bgr[:, :, 1], bgr[:, :, 2]
+    return ((r & 0xF8) << 8 | (g & 0xFC) << 3 | b >> 3).astype(">u2").tobytes()
+
+# Block truncation coding, fixed at 6 bytes per 4x4 block: [c0][c1][mask], mask bit 15 = top left
+# pixel, row by row, set = c1. Pixels brighter than the block's mean luma take c1, the others c0,
+# and each color is the mean of its pixels (AMBTC), averaged in RGB565 levels.
+BTC_BLOCK = 4
+
+def btc_payload(frame, width, height):
+    if width % BTC_BLOCK or height % BTC_BLOCK:
+        raise ValueError(f"BTC frames need a width and height that are multiples of {BTC_BLOCK}.")
+
+    bw, bh = width // BTC_BLOCK, height // BTC_BLOCK
+    px = np.frombuffer(bytes(frame), dtype=">u2").astype(np.int32)
+    px = px.reshape(bh, BTC_BLOCK, bw, BTC_BLOCK).transpose(0, 2, 1, 3).reshape(-1, BTC_BLOCK * BTC_BLOCK)
+    levels = np.stack([px >> 11, px >> 5 & 0x3F, px & 0x1F], axis=-1).astype(np.float32)
+    luma = levels @ np.array([0.299 / 31, 0.587 / 63, 0.114 / 31], dtype=np.float32)
+
+    hi = luma > luma.mean(axis=1, keepdims=True)
+    n_hi = hi.sum(axis=1, keepdims=True)
+    n_lo = BTC_BLOCK * BTC_BLOCK - n_hi
+    sum_hi = (levels * hi[..., None]).sum(axis=1)
+    sum_lo = (levels * ~hi[..., None]).sum(axis=1)
+    c0 = np.rint(sum_lo / n_lo).astype(np.int32)
+    c1 = np.where(n_hi > 0, np.rint(sum_hi / np.maximum(n_hi, 1)), c0).astype(np.int32)
+
+    def rgb565(c):
+        return c[:, 0] << 11 | c[:, 1] << 5 | c[:, 2]
+
+    mask = (hi << np.arange(15, -1, -1)).sum(axis=1)
+    blocks = np.column_stack([rgb565(c0), rgb565(c1), mask]).astype(">u2")
+    return blocks.tobytes()
+
+def btc_expand(payload, width, height):
+    bw, bh = width // BTC_BLOCK, height // BTC_BLOCK
+    blocks = np.frombuffer(payload, dtype=">u2").reshape(-1, 3).astype(np.int32)
+    bits = blocks[:, 2:3] >> np.arange(15, -1, -1) & 1
+    px = np.where(bits == 1, blocks[:, 1:2], blocks[:, 0:1])
+    px = px.reshape(bh, bw, BTC_BLOCK, BTC_BLOCK).transpose(0, 2, 1, 3).reshape(height, width)
+    return px.astype(">u2").tobytes()
+
+# Vector quantization: each frame carries a codebook of up to 256 2x2 patches (top left, top right,
+# bottom left, bottom right) found with k-means over the frame's blocks, in RGB565 levels; pixels are
+# one codebook index per block, 2 bits per pixel. Frames with at most 256 distinct blocks are exact.
+# k-means is slow in Python, so c_to_vid_bin runs it for all frames in a process pool.
+VQ_BLOCK = 2
+VQ_MAX_ENTRIES = 256
+VQ_ITERATIONS = 8
+
+def vq_blocks(frame, width, height):
+    px = np.frombuffer(bytes(frame), dtype=">u2").astype(np.int32)
+    return px.reshape(height // VQ_BLOCK, VQ_BLOCK, width // VQ_BLOCK, VQ_BLOCK).transpose(0, 2, 1, 3).reshape(-1, 4)
+
+def vq_nearest(vectors, centers):
+    # squared distances without the |v|^2 term, which is the same for every center
+    dist = (centers ** 2).sum(axis=1) - 2 * vectors @ centers.T
+    return dist.argmin(axis=1)
+
+def vq_payload(frame, width, height):
+    if width % VQ_BLOCK or height % VQ_BLOCK:
+        raise ValueError(f"VQ frames need a width and height that are multiples of {VQ_BLOCK}.")
+
+    blocks = vq_blocks(frame, width, height)
+    unique, indices = np.unique(blocks, axis=0, return_inverse=True)
+    if len(unique) <= VQ_MAX_ENTRIES:
+        codebook = unique
+    else:
+        # 12 levels per block: R, G, B of each pixel, G halved so each channel has 5 bits of range
+        levels = np.concatenate([blocks >> 11, (blocks >> 5 & 0x3F) / 2, blocks & 0x1F], axis=1).astype(np.float32)
+
+        # k-means++ seeding on a sample, then Lloyd iterations over all blocks
+        rng = np.random.default_rng(0)
+        sample = levels[rng.choice(len(levels), min(len(levels), 4 * VQ_MAX_ENTRIES), replace=False)]
+        centers = [sample[0]]
+        dist = ((sample - centers[0]) ** 2).sum(axis=1)
+        for _ in range(VQ_MAX_ENTRIES - 1):
+            centers.append(sample[rng.choice(len(sample), p=dist / dist.sum())] if dist.sum() > 0 else sample[0])
+            dist = np.minimum(dist, ((sample - centers[-1]) ** 2).sum(axis=1))
+        centers = np.array(centers)
+
+        for _ in range(VQ_ITERATIONS):
+            indices = vq_nearest(levels, centers)
+            counts = np.bincount(indices, minlength=VQ_MAX_ENTRIES)
+            for c in range(levels.shape[1]):
+                sums = np.bincount(indices, weights=levels[:, c], minlength=VQ_MAX_ENTRIES)
+                centers[:, c] = np.where(counts > 0, sums / np.maximum(counts, 1), centers[:, c])
+
+        r, g, b = (np.rint(centers[:, i * 4:(i + 1) * 4]).astype(np.int32) for i in range(3))
+        codebook = r.clip(0, 31) << 11 | (g * 2).clip(0, 63) << 5 | b.clip(0, 31)
+
+        # indices of the rounded codebook
+        cb_levels = np.concatenate([codebook >> 11, (codebook >> 5 & 0x3F) / 2, codebook & 0x1F], axis=1)
+        indices = vq_nearest(levels, cb_levels.astype(np.float32))
+
+    return (struct.pack(">H", len(codebook)) + codebook.astype(">u2").tobytes()
+            + indices.reshape(-1).astype(np.uint8).tobytes())
+
+def vq_expand(payload, width, height):
+    entries = struct.unpack(">H", payload[:2])[0]
+    codebook = np.frombuffer(payload[2:2 + entries * 8], dtype=">u2").reshape(-1, 4)
+    indices = np.frombuffer(payload[2 + entries * 8:], dtype=np.uint8)
+    px = codebook[indices].reshape(height // VQ_BLOCK, width // VQ_BLOCK, VQ_BLOCK, VQ_BLOCK)
+    return px.transpose(0, 2, 1, 3).reshape(height, width).astype(">u2").tobytes()
+
+# RGB565 colors of each PNG frame, to report frames that lose colors to the palette
+def frame_color_counts(n, frames_dir):
+    counts = []
+    for i in range(1, n + 1):
+        bgr = cv2.imread(f"{frames_dir}/{i}.png").astype(np.uint32)
+        rgb565 = (bgr[:, :, 2] >> 3) << 11 | (bgr[:, :, 1] >> 2) << 5 | bgr[:, :, 0] >> 3
+        counts.append(len(np.unique(rgb565)))
+    return counts
+
+def report_color_counts(counts, max_colors):
+    over = [c for c in counts if c > max_colors]
+    if over:
+        print(f"Warning: {len(over)} of {len(counts)} frames have more than {max_colors} colors (up to {max(over)}), "
+              f"they are quantized and may show banding. Use a larger --color mode to keep them.")
+    else:
+        print(f"All frames fit in {max_colors} colors")
+
+# Motion frames: for each 8x8 block, the block of the previous (decoded) frame within
+# [-MOTION_RANGE, MOTION_RANGE - 1] pixels that differs least from it is found. Blocks that match
+# within `tolerance` (mean absolute difference in 5-bit color levels) are skipped when the vector
+# is zero and copied otherwise; the rest are sent raw. Copies are lossy, so the search runs against
+# what the player will show, not against the source frames.
+MOTION_BLOCK = 8
+MOTION_RANGE = 8
+MOTION_RAW = 0x80
+MOTION_COPY = 0x81
+MOTION_MAX_SKIP = 128
+
+def rgb565_levels(frame, width, height):
+    px = np.frombuffer(frame, dtype=">u2").reshape(height, width).astype(np.int32)
+    return np.stack([px >> 11, (px >> 5 & 0x3F) / 2, px & 0x1F]).astype(np.float32)
+
+# (dx, dy) per block, or None for raw blocks
+def motion_search(prev, cur, width, height, tolerance):
+    r = MOTION_RANGE
+    bh, bw = height // MOTION_BLOCK, width // MOTION_BLOCK
+    a = np.full((3, height + 2 * r, width + 2 * r), np.inf, dtype=np.float32)
+    a[:, r:r + height, r:r + width] = rgb565_levels(prev, width, height)
+    b = rgb565_levels(cur, width, height)
+
+    best = np.full((bh, bw), np.inf, dtype=np.float32)
+    best_mv = np.zeros((bh, bw, 2), dtype=np.int32)
+    # zero vector first: ties keep the skip
+    for dy, dx in sorted(((dy, dx) for dy in range(-r, r) for dx in range(-r, r)), key=lambda v: abs(v[0]) + abs(v[1])):
+        moved = a[:, r + dy:r + dy + height, r + dx:r + dx + width]
+        err = np.abs(moved - b).reshape(3, bh, MOTION_BLOCK, bw, MOTION_BLOCK).mean(axis=(0, 2, 4))
+        better = err < best
+        best[better] = err[better]
+        best_mv[better] = (dx, dy)
+
+    return [[tuple(best_mv[by, bx]) if best[by, bx] <= tolerance else None for bx in range(bw)] for by in range(bh)]
+
+# Payload and the frame the player will show
+def motion_payload(prev, cur, width, height, vectors):
+    a = np.frombuffer(prev, dtype=">u2").reshape(height, width)
+    b = np.frombuffer(cur, dtype=">u2").reshape(height, width)
+    shown = a.copy()
+    out = bytearray()
+    skip = 0
+
+    def flush_skip():
+        nonlocal skip
+        while skip > 0:
+            count = min(skip, MOTION_MAX_SKIP)
+            out.append(count - 1)
+            skip -= count
+
+    n = MOTION_BLOCK
+    for by, row in enumerate(vectors):
+        for bx, mv in enumerate(row):
+            y, x = by * n, bx * n
+            if mv == (0, 0):
+                skip += 1
+                continue
+
+            flush_skip()
+            if mv is None:
+                out.append(MOTION_RAW)
+                out.extend(b[y:y + n, x:x + n].tobytes())
+                shown[y:y + n, x:x + n] = b[y:y + n, x:x + n]
+            else:
+                dx, dy = mv
+                out.append(MOTION_COPY)
+                out.append((dx & 0xF) << 4 | (dy & 0xF))
+                shown[y:y + n, x:x + n] = a[y + dy:y + dy + n, x + dx:x + dx + n]
+
+    flush_skip()
+    return bytes(out), shown.tobytes()
+
+def encode_motion_frame(prev, frame_data, width, height, tolerance=1.0):
+    vectors = motion_search(prev, bytes(frame_data), width, height, tolerance)
+    payload, shown = motion_payload(prev, bytes(frame_data), width, height, vectors)
+    return FRAME_MOTION, payload, shown
+
+# Device profile written by the player's calibration pass (playback_profile.h, profile.txt on the
+# card): SD read and display throughput, the cost of a display window and decoder cycles per pixel
+# of each frame type, measured on the board.
+@dataclass
+class DeviceProfile:
+    cpu_hz: int = 84000000
+    sd_bytes_per_ms: int = 0
+    display_bytes_per_ms: int = 0
+    window_us: int = 0
+    decode: dict = field(default_factory=dict)  # frame type -> cycles per pixel
+    entropy: float = 0.0                        # entropy decoder cycles per byte
+
+def read_profile(path):
+    profile = DeviceProfile()
+    with open(path) as f:
+        for line in f:
+            fields = line.split()
+            if not fields or fields[0].startswith("#"):
+                continue
+            if fields[0] == "decode":
+                profile.decode[int(fields[1])] = float(fields[2])
+            elif fields[0] == "entropy":
+                profile.entropy = float(fields[1])
+            elif fields[0] in ("cpu_hz", "sd_bytes_per_ms", "display_bytes_per_ms", "window_us"):
+                setattr(profile, fields[0], int(fields[1]))
+
+    if profile.sd_bytes_per_ms <= 0 or profile.display_bytes_per_ms <= 0:
+        raise ValueError(f"{path} has no SD read or display throughput.")
+    return profile
+
+CALIBRATION_PATH = "/calib.bin"    # PLAYBACK_PROFILE_CALIB_PATH and PLAYBACK_PROFILE_PATH on the card
+PROFILE_PATH = "/profile.txt"
+JPEG_TILE_PIXELS = 256  # pixels of a 4:2:0 MCU, each drawn in its own window
+
+# Predicted time in microseconds to show a frame with the profile's costs. The CPU reads the
+# payload, decodes it and opens the display windows while the display DMA sends the previous band,
+# so the frame takes the longer of the two.
+# coded_len: payload bytes read when the payload is entropy coded (decoded at profile.entropy)
+def frame_time(profile, frame_type, payload, width, height, rgb444=False, coded_len=None):
+    pixel_bytes = width * height * 3 // 2 if rgb444 else width * height * 2
+    windows = 1
+    if frame_type == FRAME_DELTA:
+        windows, pixel_bytes = struct.unpack(">HI", payload[:6])
+    elif frame_type == FRAME_JPEG:
+        windows = -(-width * height // JPEG_TILE_PIXELS)
+    pixels = pixel_bytes * 2 // 3 if rgb444 else pixel_bytes // 2
+
+    cycles = 0 if frame_type == FRAME_RAW else profile.decode.get(frame_type, 0) * pixels
+    read_len = len(payload)
+    if coded_len is not None:
+        cycles += profile.entropy * len(payload)
+        read_len = coded_len
+
+    cpu_us = read_len * 1000 / profile.sd_bytes_per_ms + cycles * 1e6 / profile.cpu_hz + windows * profile.window_us
+    draw_us = pixel_bytes * 1000 / profile.display_bytes_per_ms
+    return max(cpu_us, draw_us)
+
+# Rate control: the player starts reading a frame when it is due, and its band ring only overlaps
+# reading with drawing inside a frame; nothing is read ahead. A frame that takes longer than the
+# frame period makes the next one start late, and once playback is a full period behind, frames
+# are dropped. RateControl replays that schedule with predicted frame times: the lateness carried
+# into each frame is the state of the player's buffer, and a frame's budget is what is left of its
+# period (less the headroom kept for prediction errors).
+# Without a profile, the frame read and draw times in the README are used and decoding is free.
+RATE_DEFAULT_PROFILE = DeviceProfile(sd_bytes_per_ms=1862, display_bytes_per_ms=5120)
+JPEG_RATE_QUALITY_STEP = 10     # JPEG quality is lowered in these steps while a frame is over budget
+JPEG_RATE_MIN_QUALITY = 20
+
+@dataclass
+class RateControl:
+    period_us: float
+    headroom: float = 0.1           # fraction of the period kept free
+    late_us: float = 0.0            # how late the next frame starts
+    late_frames: int = 0            # frames that made the next one late
+    dropped_frames: int = 0
+    worst_margin_us: float = float("inf")
+    worst_frame: int = 0
+
+    def budget(self):
+        return self.period_us * (1 - self.headroom) - self.late_us
+
+    # frame `index` takes time_us: its margin is the time left before the next frame is due
+    def add(self, index, time_us):
+        margin = self.period_us - self.late_us - time_us
+        if margin < self.worst_margin_us:
+            self.worst_margin_us, self.worst_frame = margin, index
+        if margin < 0:
+            self.late_frames += 1
+        self.late_us = max(0.0, -margin)
+        if self.late_us >= self.period_us:
+            self.dropped_frames += int(self.late_us // self.period_us)
+            self.late_us %= self.period_us
+
+# Predicted frame times of the video's frames (entropy coded ones through their plain payload)
+def frame_times(profile, plain_frames, frames, width, height, rgb444=False):
+    times = []
+    for (plain_type, plain), (frame_type, payload) in zip(plain_frames, frames):
+        coded_len = len(payload) if frame_type & FRAME_ENTROPY else None
+        times.append(frame_time(profile, plain_type, plain, width, height, rgb444, coded_len))
+    return times
+
+# Every way to show frame_data, as (frame type, payload, frame shown): raw, the key frame, RLE and
+# LZ, and with the previous frame on screen (prev), delta and motion frames
+def frame_encodings(prev, frame_data, key, width, height, motion=False, motion_tolerance=1.0, rgb444=False):
+    frame_data = bytes(frame_data)
+    raw = rgb444_pack(frame_data) if rgb444 else frame_data
+    encodings = [(FRAME_RAW, raw, frame_data), (FRAME_LZ, lz_encode(raw), frame_data)]
+    if key is not None:
+        encodings.append((*key, frame_data))
+    if len(raw) % 2 == 0:
+        encodings.append((FRAME_RLE, rle_encode(raw), frame_data))
+    if prev is not None:
+        rects = delta_rects(prev, frame_data, width, height)
+        encodings.append((FRAME_DELTA, delta_payload(frame_data, width, rects, rgb444), frame_data))
+        if motion:
+            encodings.append(encode_motion_frame(prev, frame_data, width, height, motion_tolerance))
+    return encodings
+
+# SD bytes read plus SPI bytes written to show a frame, or its predicted frame time with a device
+# profile (see frame_time)
+def frame_cost(frame_type, payload, width, height, rgb444=False, profile=None):
+    if profile is not None:
+        return frame_time(profile, frame_type, payload, width, height, rgb444)
+
+    if frame_type == FRAME_DELTA:
+        rect_count, pixel_bytes = struct.unpack(">HI", payload[:6])
+        return len(payload) + pixel_bytes + rect_count * DELTA_RECT_COST
+
+    return len(payload) + (width * height * 3 // 2 if rgb444 else width * height * 2)
+
+# Frame type and payload for one RGB565 frame. Coded frames fall back to raw when they do not
+# save at least (1 - max_ratio) of the raw size: raw frames are streamed without decoding.
+# codec: "raw", "rle", "lz", or "best" for the smaller of RLE and LZ per frame
+# key: (frame type, payload) of the frame in the --color format (palette or YUV), sent instead of
+# the raw frame unless RLE or LZ is smaller; frame_data is then that frame as the player shows it
+# rgb444: frame_data is quantized RGB565 (rgb444_quantize), written packed
+# profile: device profile; raw, key and coded frames are then compared by predicted frame time
+# (frame_time of a width x height frame) instead, and max_ratio is not used
+def encode_frame(frame_data, codec="raw", max_ratio=0.9, key=None, rgb444=False, profile=None, width=0, height=0):
+    frame_data = rgb444_pack(frame_data) if rgb444 else bytes(frame_data)
+    best = (FRAME_RAW, frame_data)
+    if key is not None:
+        best = key
+
+    coded = []
+    # RLE blocks are 2 bytes, packed RGB444 frames can end on half a block
+    if codec in ("rle", "best") and len(frame_data) % 2 == 0:
+        coded.append((FRAME_RLE, rle_encode(frame_data)))
+    if codec in ("lz", "best"):
+        coded.append((FRAME_LZ, lz_encode(frame_data)))
+
+    if profile is not None:
+        candidates = [(FRAME_RAW, frame_data)] + ([key] if key is not None else []) + coded
+        return min(candidates, key=lambda c: frame_time(profile, *c, width, height, rgb444))
+
+    for frame_type, payload in coded:
+        if len(payload) <= len(frame_data) * max_ratio and len(payload) < len(best[1]):
+            best = (frame_type, payload)
+
+    return best
+
+# Delta frame against `prev` when it costs at most delta_ratio of the full frame (SD bytes read plus
+# SPI bytes written, or predicted frame time with a profile), otherwise the full frame from encode_frame
+def encode_delta_frame(prev, frame_data, width, height, codec="raw", max_ratio=0.9, delta_ratio=0.8, key=None,
+                       rgb444=False, profile=None):
+    frame_type, payload = encode_frame(frame_data, codec, max_ratio, key, rgb444, profile, width, height)
+    if prev is None:
+        return frame_type, payload
+
+    frame_data = bytes(frame_data)
+    rects = delta_rects(prev, frame_data, width, height)
+    delta = delta_payload(frame_data, width, rects, rgb444)
+
+    full_cost = frame_cost(frame_type, payload, width, height, rgb444, profile)
+    if frame_cost(FRAME_DELTA, delta, width, height, rgb444, profile) <= full_cost * delta_ratio:
+        return FRAME_DELTA, delta
+
+    return frame_type, payload
+
+# Every encoding of one frame, for the calibration video (see playback_profile.h). Motion and delta
+# frames against the previous frame come first, each drawn over the frame it was made for (the
+# previous frame is sent raw again in between); then the full frame raw, as the key frame and
+# with both lossless codecs.
+def calibration_frames(prev, frame_data, key, width, height, motion=False, motion_tolerance=1.0, rgb444=False):
+    frames = []
+    frame_data = bytes(frame_data)
+    if prev is not None:
+        if motion:
+            motion_type, motion_data, _ = encode_motion_frame(prev, frame_data, width, height, motion_tolerance)
+            frames.append((motion_type, motion_data))
+            frames.append((FRAME_RAW, bytes(prev)))
+        frames.append((FRAME_DELTA, delta_payload(frame_data, width, delta_rects(prev, frame_data, width, height), rgb444)))
+
+    raw = rgb444_pack(frame_data) if rgb444 else frame_data
+    frames.append((FRAME_RAW, raw))
+    if key is not None:
+        frames.append(key)
+    if len(raw) % 2 == 0:
+        frames.append((FRAME_RLE, rle_encode(raw)))
+    frames.append((FRAME_LZ, lz_encode(raw)))
+    return frames
+
+def frame_record(frame_type, payload):
+    return FRAME_START_FLAG + struct.pack(">BI", frame_type, len(payload)) + payload
+
+# keyint: a key frame (full frame) at least every keyint frames, 0 = no delta frames.
+# Playback can only skip ahead or seek to key frames.
+# motion: also try motion frames between key frames, keeping the cheapest frame
+# color: "rgb565", "i8" / "i4" / "mono" for C arrays converted with --cf I8 / I4 / I1 (frames are
+# shown with their palette), "yuv420" for C arrays converted with --cf RGB888, "rgb444" (display
+# in 12-bit mode, no motion frames), "btc", "vq" or "jpeg" (C arrays converted with --cf RGB888)
+# mono_colors: (fg, bg) RGB888 colors that replace the two colors of mono frames
+# entropy: entropy code the coded payloads (see entropy_code)
+# jpeg_quality: quality of JPEG frames, 1-100
+# profile: DeviceProfile, frames are then chosen by predicted frame time on the board
+# calibration: write calib.bin instead, every frame in every encoding, unpaced (see calibration_frames)
+# rate_headroom: keep each frame within the frame period less this fraction of it (see RateControl):
+# a frame over budget takes its fastest encoding instead, and JPEG frames a lower quality; None = off
+def c_to_vid_bin(n, fps, input_dir, out_dir, aligned=True, codec="raw", max_ratio=0.9, keyint=0, delta_ratio=0.8,
+                 motion=False, motion_tolerance=1.0, color="rgb565", mono_colors=None, entropy=False, jpeg_quality=75,
+                 profile=None, calibration=False, rate_headroom=None):
+    out_fname = out_dir + ("/calib.bin" if calibration else "/video.bin")
     vid_width, vid_height = extract_resolution(input_dir + "/1.c")
-    START_BYTE_0 = 0x46
-    START_BYTE_1 = 0x52
-    START_BYTE_2 = 0x4D
 
+    # frames data
+    # Since pixels are RGB565, there will be double the bytes of resolution
+    # Ex: 128*160 = 20480
+    # frame_data = 40960 bytes (2 bytes per pixel)
+    if motion and (vid_width % MOTION_BLOCK or vid_height % MOTION_BLOCK):
+        raise ValueError(f"Motion frames need a width and height that are multiples of {MOTION_BLOCK}.")
+    rgb444 = color == "rgb444"
+    if rgb444 and (vid_width % 2 or motion):
+        raise ValueError("RGB444 needs an even width and no motion frames.")
+
+    vq_keys = None
+    if color == "vq":
+        print(f"Building VQ codebooks of {n} frames")
+        with ProcessPoolExecutor() as executor:
+            futures = [executor.submit(vq_payload, bytes(extract_c_to_binary(f"{input_dir}/{i}.c")), vid_width, vid_height)
+                       for i in range(1, n + 1)]
+            vq_keys = [f.result() for f in futures]
+
+    rate = None
+    rate_profile = profile or RATE_DEFAULT_PROFILE
+    if rate_headroom is not None and not calibration:
+        rate = RateControl(1e6 / fps, rate_headroom)
+        if profile is None:
+            print("Rate control without --profile: README read and draw times, decoding counted as free")
+    rate_changed = 0
+
+    frames = []
+    prev = None     # frame on screen before this one
+    since_key = 0
+    for i in range(1, n + 1):
+        frame_data = bytes(extract_c_to_binary(f"{input_dir}/{i}.c"))
+        key = None
+        if color in COLOR_BPP:
+            palette, indices = indexed_from_lvgl(frame_data, vid_width, vid_height, COLOR_BPP[color])
+            if mono_colors is not None and len(palette) <= MONO_MAX_COLORS:
+                palette = mono_recolor(palette, *mono_colors)
+            key = (palette_frame_type(palette), palette_payload(palette, indices))
+            frame_data = palette_expand(palette, indices)
+        elif color == "yuv420":
+            key = (FRAME_YUV420, yuv420_payload(rgb888_from_lvgl(frame_data, vid_width, vid_height)))
+            frame_data = yuv420_expand(key[1], vid_width, vid_height)
+        elif color == "jpeg":
+            rgb = rgb888_from_lvgl(frame_data, vid_width, vid_height)
+            key = (FRAME_JPEG, jpeg_payload(rgb, jpeg_quality))
+            frame_data = jpeg_expand(key[1])
+        elif rgb444:
+            frame_data = rgb444_quantize(frame_data)
+        elif color == "btc":
+            key = (FRAME_BTC, btc_payload(frame_data, vid_width, vid_height))
+            frame_data = btc_expand(key[1], vid_width, vid_height)
+        elif color == "vq":
+            key = (FRAME_VQ, vq_keys[i - 1])
+            frame_data = vq_expand(key[1], vid_width, vid_height)
+
+        if calibration:
+            frames.extend(calibration_frames(prev, frame_data, key, vid_width, vid_height, motion, motion_tolerance, rgb444))
+            prev = frame_data
+            print(f"frame_data {i} len={len(frame_data)} calibration frames={len(frames)}")
+            continue
+
+        shown = frame_data
+        if keyint > 0 and since_key < keyint:
+            frame_type, payload = encode_delta_frame(prev, frame_data, vid_width, vid_height, codec, max_ratio, delta_ratio, key,
+                                                     rgb444, profile)
+            if motion and prev is not None:
+                full_cost = frame_cost(*encode_frame(frame_data, codec, max_ratio, key, profile=profile, width=vid_width,
+                                                     height=vid_height), vid_width, vid_height, profile=profile)
+                cost = frame_cost(frame_type, payload, vid_width, vid_height, profile=profile)
+                motion_type, motion_data, motion_shown = encode_motion_frame(prev, frame_data, vid_width, vid_height, motion_tolerance)
+                motion_cost = frame_cost(motion_type, motion_data, vid_width, vid_height, profile=profile)
+                if motion_cost < cost and motion_cost <= full_cost * delta_ratio:
+                    frame_type, payload, shown = motion_type, motion_data, motion_shown
+        else:
+            frame_type, payload = encode_frame(frame_data, codec, max_ratio, key, rgb444, profile, vid_width, vid_height)
+
+        # over budget: the fastest encoding, then lower JPEG qualities while the JPEG frame is the
+        # fastest and shrinking it helps. Other encodings keep the original quality's pixels, so later
+        # delta frames are not built on a degraded frame.
+        if rate is not None and frame_time(rate_profile, frame_type, payload, vid_width, vid_height, rgb444) > rate.budget():
+            delta_prev = prev if keyint > 0 and since_key < keyint else None
+            encoding_time = lambda e: frame_time(rate_profile, e[0], e[1], vid_width, vid_height, rgb444)
+            encodings = frame_encodings(delta_prev, frame_data, key, vid_width, vid_height, motion, motion_tolerance, rgb444)
+            fastest = min(encodings, key=encoding_time)
+            quality = jpeg_quality
+            while color == "jpeg" and fastest[0] == FRAME_JPEG and quality > JPEG_RATE_MIN_QUALITY and \
+                    encoding_time(fastest) > rate.budget():
+                lower = max(quality - JPEG_RATE_QUALITY_STEP, JPEG_RATE_MIN_QUALITY)
+                jpeg = jpeg_payload(rgb, lower)
+                if encoding_time((FRAME_JPEG, jpeg)) >= encoding_time(fastest):
+                    break
+                quality = lower
+                fastest = (FRAME_JPEG, jpeg, jpeg_expand(jpeg))
+
+            frame_type, payload, shown = fastest
+            rate_changed += 1
+            print(f"frame {i} over budget: type={frame_type}" + (f" quality={quality}" if color == "jpeg" else ""))
+        if rate is not None:
+            rate.add(i, frame_time(rate_profile, frame_type, payload, vid_width, vid_height, rgb444))
+
+        since_key = since_key + 1 if frame_type in (FRAME_DELTA, FRAME_MOTION) else 1
+        prev = shown
+        print(f"frame_data {i} len={len(frame_data)} type={frame_type} payload={len(payload)}")
+        frames.append((frame_type, payload))
+
+    coded = sum(1 for frame_type, _ in frames if frame_type == FRAME_RLE)
+    deltas = sum(1 for frame_type, _ in frames if frame_type == FRAME_DELTA)
+    motions = sum(1 for frame_type, _ in frames if frame_type == FRAME_MOTION)
+    i8 = sum(1 for frame_type, _ in frames if frame_type == FRAME_I8)
+    i4 = sum(1 for frame_type, _ in frames if frame_type == FRAME_I4)
+    mono = sum(1 for frame_type, _ in frames if frame_type == FRAME_MONO)
+    yuv = sum(1 for frame_type, _ in frames if frame_type == FRAME_YUV420)
+    btc = sum(1 for frame_type, _ in frames if frame_type == FRAME_BTC)
+    vq = sum(1 for frame_type, _ in frames if frame_type == FRAME_VQ)
+    lz = sum(1 for frame_type, _ in frames if frame_type == FRAME_LZ)
+    jpeg = sum(1 for frame_type, _ in frames if frame_type == FRAME_JPEG)
+    print(f"{n} frames: {coded} rle, {lz} lz, {deltas} delta, {motions} motion, {i8} i8, {i4} i4, {mono} mono, "
+          f"{yuv} yuv420, {btc} btc, {vq} vq, {jpeg} jpeg")
+
+    table = None
+    plain_frames = frames
+    if entropy:
+        plain_len = sum(len(payload) for frame_type, payload in frames if frame_type != FRAME_RAW)
+        # with rate control, a payload is only coded when that does not slow its frame down
+        frames, table = entropy_code(frames, rate_profile if rate is not None else profile, vid_width, vid_height, rgb444)
+        entropy_frames = [payload for frame_type, payload in frames if frame_type & FRAME_ENTROPY]
+        coded_len = sum(len(payload) for frame_type, payload in frames if frame_type != FRAME_RAW)
+        print(f"entropy coded {len(entropy_frames)} frames, coded payloads {plain_len} -> {coded_len} bytes")
+
+    # final schedule, entropy coding included: worst margin before the next frame is due
+    if rate is not None:
+        rate = RateControl(rate.period_us, rate.headroom)
+        for index, time_us in enumerate(frame_times(rate_profile, plain_frames, frames, vid_width, vid_height, rgb444)):
+            rate.add(index + 1, time_us)
+        print(f"rate control at {fps:.2f} fps ({rate.period_us / 1000:.1f} ms per frame): {rate_changed} frames re-encoded, "
+              f"worst margin {rate.worst_margin_us / 1000:.1f} ms (frame {rate.worst_frame}), "
+              f"{rate.late_frames} late, {rate.dropped_frames} dropped")
+
+    if profile is not None:
+        unmeasured = sorted({frame_type & ~FRAME_ENTROPY for frame_type, _ in frames} - set(profile.decode) - {FRAME_RAW})
+        if unmeasured:
+            print(f"warning: the profile has no decode cost for frame types {unmeasured}, counted as free "
+                  f"(calibrate with the same --color, --motion and --entropy options)")
+
+    # the calibration video plays unpaced, as fast as the player can show it
     with open(out_fname, 'wb') as out_file:
-        bin_data = bytearray()
-
-        # append video resolution
-        bin_data.append((vid_width >> 8) & 0xFF)
-        bin_data.append(vid_width & 0xFF)
-        bin_data.append((vid_height >> 8) & 0xFF)
-        bin_data.append(vid_height & 0xFF)
-
-        # append number of frames
-        bin_data.append((n >> 8) & 0xFF)
-        bin_data.append(n & 0xFF)
-
-        # append frames data
-        # Since pixels are RGB565, there will be double the bytes of resolution
-        # Ex: 128*160 = 20480
-        # frame_data = 40960 bytes (2 bytes per pixel)
-        for i in range(1, n + 1):
-            bin_data.append(START_BYTE_0)
-            bin_data.append(START_BYTE_1)
-            bin_data.append(START_BYTE_2)
-
-            frame_data = extract_c_to_binary(f"{input_dir}/{i}.c")
-            print(f"frame_data {i} len={len(frame_data)}")
-            bin_data.extend(frame_data)
-
-        out_file.write(bin_data)
-
-def vid_to_frames(video_path, output_dir, target_width, target_height, start_time=None, end_time=None):
+        out_file.write(vid_bin(vid_width, vid_height, 0 if calibration else fps, frames, aligned,
+                               VID_FLAG_RGB444 if rgb444 else 0, table))
+    if calibration:
+        print(f"{len(frames)} calibration frames: copy {out_fname} to the card as {CALIBRATION_PATH} "
+              f"and delete {PROFILE_PATH} from the card to calibrate again")
+
+# Returns (num_frames, fps). With target_fps below the source frame rate, source frames are dropped
+# so the output plays at target_fps.
+def vid_to_frames(video_path, output_dir, target_width, target_height, start_time=None, end_time=None, target_fps=None):
     os.makedirs(output_dir, exist_ok=True)
 
     cap = cv2.VideoCapture(video_path)
@@ -130,12 +1258,23 @@ def vid_to_frames(video_path, output_dir, target_width, target_height, start_tim
 
     cap.set(cv2.CAP_PROP_POS_FRAMES, start_frame)  
 
+    out_fps = fps
+    if target_fps is not None and target_fps < fps:
+        out_fps = target_fps
+
     frame_index = 1
+    src_index = 0
     while cap.get(cv2.CAP_PROP_POS_FRAMES) < end_frame:  # stop based on end_frame
         ret, frame = cap.read()
         if not ret:
             break
 
+        # keep a source frame only when it starts a new output frame slot
+        out_slot = int(src_index * out_fps / fps)
+        src_index += 1
+        if out_slot < frame_index - 1:
+            continue
+
         resized = cv2.resize(frame, (target_width, target_height), interpolation=cv2.INTER_AREA)
 
         out_path = os.path.join(output_dir, f"{frame_index}.png") 
@@ -145,8 +1284,8 @@ def vid_to_frames(video_path, output_dir, target_width, target_height, start_tim
     cap.release()
 
     num_frames = frame_index - 1
-    print(f"Saved {num_frames} frames to '{output_dir}/'")
-    return num_frames
+    print(f"Saved {num_frames} frames to '{output_dir}/' at {out_fps:.2f} fps")
+    return num_frames, out_fps
 
 def clear_dirs(folders):
     for folder in folders:
@@ -173,12 +1312,38 @@ def time_str_to_seconds(tstr):
         print("Invalid time format. Use MM:SS")
         exit()
 
+def parse_mono_colors(value):
+    if not value:
+        return None
+    try:
+        fg, bg = (int(c, 16) for c in value.split(','))
+        return fg, bg
+    except ValueError:
+        print("Invalid --mono-colors. Use FG,BG in hex, e.g. FFFFFF,000000")
+        exit()
+
 def accept_args():
     parser = argparse.ArgumentParser(description="Convert video to binary format for display.")
     parser.add_argument("video_input", help="Path to input video")
     parser.add_argument("--start", help="Start time MM:SS", default=None)
     parser.add_argument("--end", help="End time MM:SS", default=None)
     parser.add_argument("--landscape", action="store_true", help="Use landscape mode for display")
+    parser.add_argument("--fps", type=float, default=None, help="Playback frame rate (default: source frame rate)")
+    parser.add_argument("--color", choices=["rgb565", "i8", "i4", "mono", "yuv420", "rgb444", "btc", "vq", "jpeg"], default="rgb565", help="Key frame pixels: rgb565, a palette per frame of 256 (i8), 16 (i4) or 2 (mono) colors, yuv420 at 12 bits per pixel, rgb444 (12 bits per pixel on the card and display bus), btc at a fixed 3 bits per pixel, vq (codebook of 2x2 patches per frame), or jpeg (baseline JPEG per frame, player needs ~3KB more RAM) (default: rgb565)")
+    parser.add_argument("--jpeg-quality", type=int, default=75, help="Quality of jpeg frames, 1-100 (default: 75)")
+    parser.add_argument("--mono-colors", default=None, metavar="FG,BG", help="RGB888 hex colors for mono frames, e.g. FFB000,000000 (default: quantized colors)")
+    parser.add_argument("--codec", choices=["raw", "rle", "lz", "best"], default="rle", help="Lossless frame codec, best = smaller of rle and lz per frame (default: rle, raw per frame when it does not pay off)")
+    parser.add_argument("--max-ratio", type=float, default=0.9, help="Largest coded/raw size ratio for a coded frame (default: 0.9)")
+    parser.add_argument("--keyint", type=int, default=30, help="Key frame interval for delta frames, 0 to disable (default: 30)")
+    parser.add_argument("--delta-ratio", type=float, default=0.8, help="Largest delta/full cost ratio for a delta frame (default: 0.8)")
+    parser.add_argument("--motion", action="store_true", help="Also use motion-compensated frames between key frames (player needs ~44KB RAM)")
+    parser.add_argument("--motion-tolerance", type=float, default=1.0, help="Largest mean color error of a copied block, in 5-bit levels (default: 1.0)")
+    parser.add_argument("--entropy", action="store_true", help="Huffman code the coded frame payloads with one code table per video (player needs ~3KB more RAM)")
+    parser.add_argument("--no-align", action="store_true", help="Pack frames without sector alignment (smaller file, slower reads)")
+    parser.add_argument("--profile", default=None, metavar="PROFILE_TXT", help="Device profile written by the player's calibration pass: choose each frame's encoding by its predicted frame time on the board instead of by bytes (--max-ratio is not used)")
+    parser.add_argument("--rate-control", action="store_true", help="Keep every frame within its frame period at the target frame rate, by the --profile times (default: README timings): frames over budget take their fastest encoding, and jpeg frames a lower quality; reports the worst margin")
+    parser.add_argument("--rate-headroom", type=float, default=0.1, help="Fraction of the frame period rate control keeps free for prediction errors (default: 0.1)")
+    parser.add_argument("--calibration", action="store_true", help=f"Write calib.bin for the player's calibration pass instead: every frame in every encoding of the other options, unpaced; copy it to the card as {CALIBRATION_PATH}")
     
     args = parser.parse_args()
     return args
@@ -194,6 +1359,7 @@ class Config:
 def main():
     config = Config()
     args = accept_args()
+    profile = read_profile(args.profile) if args.profile else None
 
     if args.landscape:
         print("Using landscape mode")
@@ -205,14 +1371,23 @@ def main():
     clear_dirs([config.frames_dir, config.c_frame_dir, config.vid_bin_dir])
 
     # convert to PNG frames
-    n = vid_to_frames(args.video_input, config.frames_dir, config.target_width, config.target_height, start_sec, end_sec)
+    n, fps = vid_to_frames(args.video_input, config.frames_dir, config.target_width, config.target_height, start_sec, end_sec, args.fps)
 
     # convert to C arrays
-    lvgl_convert_to_c(n, config.frames_dir)
+    if args.color in COLOR_BPP:
+        report_color_counts(frame_color_counts(n, config.frames_dir), 1 << COLOR_BPP[args.color])
+
+    lvgl_cf = {"rgb565": "RGB565_SWAPPED", "rgb444": "RGB565_SWAPPED", "btc": "RGB565_SWAPPED", "vq": "RGB565_SWAPPED", "yuv420": "RGB888", "jpeg": "RGB888"}.get(args.color) or f"I{COLOR_BPP[args.color]}"
+    lvgl_convert_to_c(n, config.frames_dir, lvgl_cf)
     clear_dirs([config.frames_dir])
 
     # convert to video binary
-    c_to_vid_bin(n, config.c_frame_dir, config.vid_bin_dir)
+    c_to_vid_bin(n, fps, config.c_frame_dir, config.vid_bin_dir, aligned=not args.no_align,
+                 codec=args.codec, max_ratio=args.max_ratio, keyint=args.keyint, delta_ratio=args.delta_ratio,
+                 motion=args.motion, motion_tolerance=args.motion_tolerance, color=args.color,
+                 mono_colors=parse_mono_colors(args.mono_colors), entropy=args.entropy,
+                 jpeg_quality=args.jpeg_quality, profile=profile, calibration=args.calibration,
+                 rate_headroom=args.rate_headroom if args.rate_control else None)
     clear_dirs([config.c_frame_dir])
 
 if __name__ == "__main__":